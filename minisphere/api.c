@@ -2,7 +2,24 @@
 #include "api.h"
 #include "color.h"
 
-static duk_ret_t duk_on_create_error (duk_context* ctx);
+struct api_prop
+{
+	void* name_ptr;
+	void* getter_ptr;
+	void* setter_ptr;
+};
+
+struct api_type
+{
+	char*            name;
+	void*            proto_ptr;
+	void*            dtor_ptr;
+	void*            key_ptr;
+	int              num_props;
+	struct api_prop* props;
+};
+
+static duk_ret_t        duk_on_create_error (duk_context* ctx);
 
 static duk_ret_t js_GetVersion           (duk_context* ctx);
 static duk_ret_t js_GetVersionString     (duk_context* ctx);
@@ -33,11 +50,23 @@ static duk_ret_t js_GarbageCollect       (duk_context* ctx);
 static duk_ret_t js_RestartGame          (duk_context* ctx);
 static duk_ret_t js_UnskipFrame          (duk_context* ctx);
 
-static int s_framerate = 0;
+static int              s_framerate = 0;
+static int              s_max_types = 0;
+static int              s_num_types = 0;
+static struct api_type* s_types     = NULL;
 
 void
 init_api(duk_context* ctx)
 {
+	int i;
+
+	// types registered with a previous Duktape heap are stale now
+	for (i = 0; i < s_num_types; ++i) {
+		free(s_types[i].name);
+		free(s_types[i].props);
+	}
+	s_num_types = 0;
+	
 	register_api_func(ctx, NULL, "GetVersion", js_GetVersion);
 	register_api_func(ctx, NULL, "GetVersionString", js_GetVersionString);
 	register_api_func(ctx, NULL, "GetExtensions", js_GetExtensions);
@@ -106,6 +135,173 @@ register_api_func(duk_context* ctx, const char* ctor_name, const char* name, duk
 	duk_pop(ctx);
 }
 
+int
+register_api_type(duk_context* ctx, const char* name, duk_c_function finalizer)
+{
+	// native-backed objects share one prototype per type, kept in the stash. the
+	// finalizer is stored under a private key rather than set on the prototype:
+	// Duktape looks finalizers up through the prototype chain and would otherwise
+	// run it for the prototype object too. the returned ID indexes the type table
+	// directly and is what the other functions here take, so no name lookup is
+	// needed after registration.
+	
+	struct api_type* new_types;
+	char*            type_name;
+	struct api_type* type;
+	int              new_max;
+
+	if (s_num_types + 1 > s_max_types) {
+		new_max = (s_num_types + 1) * 2;
+		if (!(new_types = realloc(s_types, new_max * sizeof(struct api_type))))
+			duk_error_ni(ctx, -1, DUK_ERR_ERROR, "Failed to register type '%s' (internal error)", name);
+		s_types = new_types;
+		s_max_types = new_max;
+	}
+	if (!(type_name = strdup(name)))
+		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "Failed to register type '%s' (internal error)", name);
+	type = &s_types[s_num_types++];
+	type->name = type_name;
+	type->dtor_ptr = NULL;
+	type->num_props = 0;
+	type->props = NULL;
+	duk_push_global_stash(ctx);
+	if (!duk_get_prop_string(ctx, -1, "prototypes")) {
+		duk_pop(ctx);
+		duk_push_object(ctx); duk_put_prop_string(ctx, -2, "prototypes");
+		duk_get_prop_string(ctx, -1, "prototypes");
+	}
+	duk_push_object(ctx);
+	type->proto_ptr = duk_get_heapptr(ctx, -1);
+	if (finalizer != NULL) {
+		duk_push_c_function(ctx, finalizer, DUK_VARARGS);
+		type->dtor_ptr = duk_get_heapptr(ctx, -1);
+		duk_put_prop_string(ctx, -2, "\xFF" "dtor");
+	}
+	
+	// the handle key is interned once here. the prototype holds on to it, so its
+	// heap pointer stays valid and can be pushed directly on every access.
+	duk_push_sprintf(ctx, "\xFF" "udata:%s", name);
+	type->key_ptr = duk_get_heapptr(ctx, -1);
+	duk_put_prop_string(ctx, -2, "\xFF" "udata_key");
+	duk_put_prop_string(ctx, -2, name);
+	duk_pop_2(ctx);
+	return s_num_types - 1;
+}
+
+void
+register_api_method(duk_context* ctx, int type_id, const char* name, duk_c_function fn)
+{
+	struct api_type* type;
+
+	type = &s_types[type_id];
+	duk_push_heapptr(ctx, type->proto_ptr);
+	duk_push_c_function(ctx, fn, DUK_VARARGS);
+	duk_put_prop_string(ctx, -2, name);
+	duk_pop(ctx);
+}
+
+void
+register_api_prop(duk_context* ctx, int type_id, const char* name, duk_c_function getter, duk_c_function setter)
+{
+	// accessors are defined on each instance by duk_push_sphere_obj(), so that they
+	// show up as own properties to hasOwnProperty(), Object.keys() and JSON.stringify()
+	// like plain properties do. the functions are created once and kept alive by
+	// the prototype.
+	
+	struct api_prop* new_props;
+	struct api_prop* prop;
+	struct api_type* type;
+
+	type = &s_types[type_id];
+	if (!(new_props = realloc(type->props, (type->num_props + 1) * sizeof(struct api_prop))))
+		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "Failed to register property '%s' (internal error)", name);
+	type->props = new_props;
+	prop = &type->props[type->num_props++];
+	duk_push_heapptr(ctx, type->proto_ptr);
+	duk_push_array(ctx);
+	duk_push_string(ctx, name);
+	prop->name_ptr = duk_get_heapptr(ctx, -1);
+	duk_put_prop_index(ctx, -2, 0);
+	duk_push_c_function(ctx, getter, DUK_VARARGS);
+	prop->getter_ptr = duk_get_heapptr(ctx, -1);
+	duk_put_prop_index(ctx, -2, 1);
+	duk_push_c_function(ctx, setter, DUK_VARARGS);
+	prop->setter_ptr = duk_get_heapptr(ctx, -1);
+	duk_put_prop_index(ctx, -2, 2);
+	duk_push_sprintf(ctx, "\xFF" "prop:%s", name);
+	duk_swap_top(ctx, -2);
+	duk_put_prop(ctx, -3);
+	duk_pop(ctx);
+}
+
+void
+duk_push_sphere_obj(duk_context* ctx, int type_id, void* udata)
+{
+	struct api_type* type;
+	
+	int i;
+
+	type = &s_types[type_id];
+	duk_push_object(ctx);
+	duk_push_heapptr(ctx, type->proto_ptr);
+	duk_set_prototype(ctx, -2);
+	for (i = 0; i < type->num_props; ++i) {
+		duk_push_heapptr(ctx, type->props[i].name_ptr);
+		duk_push_heapptr(ctx, type->props[i].getter_ptr);
+		duk_push_heapptr(ctx, type->props[i].setter_ptr);
+		duk_def_prop(ctx, -4, DUK_DEFPROP_HAVE_GETTER | DUK_DEFPROP_HAVE_SETTER
+			| DUK_DEFPROP_HAVE_ENUMERABLE | DUK_DEFPROP_ENUMERABLE
+			| DUK_DEFPROP_HAVE_CONFIGURABLE | DUK_DEFPROP_CONFIGURABLE);
+	}
+	if (type->dtor_ptr != NULL) {
+		duk_push_heapptr(ctx, type->dtor_ptr);
+		duk_set_finalizer(ctx, -2);
+	}
+	if (udata != NULL) {
+		duk_push_heapptr(ctx, type->key_ptr);
+		duk_push_pointer(ctx, udata);
+		duk_put_prop(ctx, -3);
+	}
+}
+
+void*
+duk_require_sphere_obj(duk_context* ctx, duk_idx_t index, int type_id)
+{
+	// the handle is keyed by type, so a single property fetch both checks the type
+	// and retrieves the pointer. hidden keys bypass Proxy traps, which lets this
+	// work for byte arrays as well.
+	
+	struct api_type* type;
+	void*            udata;
+
+	index = duk_require_normalize_index(ctx, index);
+	type = &s_types[type_id];
+	if (!duk_is_object(ctx, index))
+		goto on_error;
+	duk_push_heapptr(ctx, type->key_ptr);
+	if (!duk_get_prop(ctx, index)) {
+		duk_pop(ctx);
+		goto on_error;
+	}
+	udata = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	return udata;
+
+on_error:
+	duk_error_ni(ctx, -1, DUK_ERR_TYPE_ERROR, "Object is not a Sphere %s", type->name);
+}
+
+void
+duk_set_sphere_obj(duk_context* ctx, duk_idx_t index, int type_id, void* udata)
+{
+	struct api_type* type;
+
+	index = duk_require_normalize_index(ctx, index);
+	type = &s_types[type_id];
+	duk_push_heapptr(ctx, type->key_ptr);
+	duk_push_pointer(ctx, udata);
+	duk_put_prop(ctx, index);
+}
+
 noreturn
 duk_error_ni(duk_context* ctx, int blame_offset, duk_errcode_t err_code, const char* fmt, ...)
 {
@@ -206,7 +402,8 @@ js_EvaluateScript(duk_context* ctx)
 	char* script_path = get_asset_path(script_file, "scripts", false);
 	if (!al_filename_exists(script_path))
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "EvaluateScript(): Script file not found '%s'", script_file);
-	duk_eval_file_noresult(ctx, script_path);
+	if (!evaluate_script(script_path))
+		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "EvaluateScript(): Failed to read script file '%s'", script_file);
 	free(script_path);
 	return 0;
 }
@@ -218,7 +415,8 @@ js_EvaluateSystemScript(duk_context* ctx)
 	char* script_path = get_sys_asset_path(script_file, "system/scripts");
 	if (!al_filename_exists(script_path))
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "EvaluateSystemScript(): System script not found '%s'", script_file);
-	duk_eval_file_noresult(ctx, script_path);
+	if (!evaluate_script(script_path))
+		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "EvaluateSystemScript(): Failed to read system script '%s'", script_file);
 	free(script_path);
 	return 0;
 }
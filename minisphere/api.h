@@ -1,7 +1,13 @@
 typedef enum js_error js_error_t;
 
-extern void init_api           (duk_context* ctx);
-extern void register_api_const (duk_context* ctx, const char* name, double value);
-extern void register_api_func  (duk_context* ctx, const char* ctor_name, const char* name, duk_c_function fn);
+extern void  init_api               (duk_context* ctx);
+extern void  register_api_const     (duk_context* ctx, const char* name, double value);
+extern void  register_api_func      (duk_context* ctx, const char* ctor_name, const char* name, duk_c_function fn);
+extern int   register_api_type      (duk_context* ctx, const char* name, duk_c_function finalizer);
+extern void  register_api_method    (duk_context* ctx, int type_id, const char* name, duk_c_function fn);
+extern void  register_api_prop      (duk_context* ctx, int type_id, const char* name, duk_c_function getter, duk_c_function setter);
+extern void  duk_push_sphere_obj    (duk_context* ctx, int type_id, void* udata);
+extern void* duk_require_sphere_obj (duk_context* ctx, duk_idx_t index, int type_id);
+extern void  duk_set_sphere_obj     (duk_context* ctx, duk_idx_t index, int type_id, void* udata);
 
 extern noreturn duk_error_ni (duk_context* ctx, int blame_offset, duk_errcode_t err_code, const char* fmt, ...);
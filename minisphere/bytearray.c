@@ -21,6 +21,8 @@ struct bytearray
 	int      size;
 };
 
+static int s_bytearray_type = -1;
+
 bytearray_t*
 new_bytearray(int size)
 {
@@ -132,18 +134,24 @@ init_bytearray_api(void)
 	register_api_func(g_duktape, NULL, "CreateByteArrayFromString", js_CreateByteArrayFromString);
 	register_api_func(g_duktape, NULL, "CreateStringFromByteArray", js_CreateStringFromByteArray);
 	register_api_func(g_duktape, NULL, "HashByteArray", js_HashByteArray);
+	s_bytearray_type = register_api_type(g_duktape, "ByteArray", js_ByteArray_finalize);
+	register_api_method(g_duktape, s_bytearray_type, "toString", js_ByteArray_toString);
+	register_api_method(g_duktape, s_bytearray_type, "concat", js_ByteArray_concat);
+	register_api_method(g_duktape, s_bytearray_type, "slice", js_ByteArray_slice);
+
+	// all byte arrays share a single Proxy handler
+	duk_push_global_stash(g_duktape);
+	duk_push_object(g_duktape);
+	duk_push_c_function(g_duktape, js_ByteArray_getProp, DUK_VARARGS); duk_put_prop_string(g_duktape, -2, "get");
+	duk_push_c_function(g_duktape, js_ByteArray_setProp, DUK_VARARGS); duk_put_prop_string(g_duktape, -2, "set");
+	duk_put_prop_string(g_duktape, -2, "bytearray_handler");
+	duk_pop(g_duktape);
 }
 
 void
 duk_push_sphere_bytearray(duk_context* ctx, bytearray_t* array)
 {
-	duk_push_object(ctx);
-	duk_push_string(ctx, "bytearray"); duk_put_prop_string(ctx, -2, "\xFF" "sphere_type");
-	duk_push_pointer(ctx, array); duk_put_prop_string(ctx, -2, "\xFF" "ptr");
-	duk_push_c_function(ctx, js_ByteArray_finalize, DUK_VARARGS); duk_set_finalizer(ctx, -2);
-	duk_push_c_function(ctx, js_ByteArray_toString, DUK_VARARGS); duk_put_prop_string(ctx, -2, "toString");
-	duk_push_c_function(ctx, js_ByteArray_concat, DUK_VARARGS); duk_put_prop_string(ctx, -2, "concat");
-	duk_push_c_function(ctx, js_ByteArray_slice, DUK_VARARGS); duk_put_prop_string(ctx, -2, "slice");
+	duk_push_sphere_obj(ctx, s_bytearray_type, array);
 	duk_push_string(ctx, "length"); duk_push_int(ctx, array->size);
 	duk_def_prop(ctx, -3,
 		DUK_DEFPROP_HAVE_CONFIGURABLE | 0
@@ -154,9 +162,9 @@ duk_push_sphere_bytearray(duk_context* ctx, bytearray_t* array)
 	duk_push_global_object(ctx);
 	duk_get_prop_string(ctx, -1, "Proxy");
 	duk_dup(ctx, -3);
-	duk_push_object(ctx);
-	duk_push_c_function(ctx, js_ByteArray_getProp, DUK_VARARGS); duk_put_prop_string(ctx, -2, "get");
-	duk_push_c_function(ctx, js_ByteArray_setProp, DUK_VARARGS); duk_put_prop_string(ctx, -2, "set");
+	duk_push_global_stash(ctx);
+	duk_get_prop_string(ctx, -1, "bytearray_handler");
+	duk_remove(ctx, -2);
 	duk_new(ctx, 2);
 	duk_remove(ctx, -2);
 	duk_remove(ctx, -2);
@@ -165,20 +173,7 @@ duk_push_sphere_bytearray(duk_context* ctx, bytearray_t* array)
 bytearray_t*
 duk_require_sphere_bytearray(duk_context* ctx, duk_idx_t index)
 {
-	bytearray_t* array;
-	const char*  type;
-
-	index = duk_require_normalize_index(ctx, index);
-	duk_require_object_coercible(ctx, index);
-	if (!duk_get_prop_string(ctx, index, "\xFF" "sphere_type"))
-		goto on_error;
-	type = duk_get_string(ctx, -1); duk_pop(ctx);
-	if (strcmp(type, "bytearray") != 0) goto on_error;
-	duk_get_prop_string(ctx, index, "\xFF" "ptr"); array = duk_get_pointer(ctx, -1); duk_pop(ctx);
-	return array;
-
-on_error:
-	duk_error_ni(ctx, -1, DUK_ERR_TYPE_ERROR, "Not a Sphere byte array");
+	return duk_require_sphere_obj(ctx, index, s_bytearray_type);
 }
 
 static duk_ret_t
@@ -232,7 +227,7 @@ js_ByteArray_finalize(duk_context* ctx)
 {
 	bytearray_t* array;
 	
-	duk_get_prop_string(ctx, 0, "\xFF" "ptr"); array = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	array = duk_require_sphere_obj(ctx, 0, s_bytearray_type);
 	free_bytearray(array);
 	return 0;
 }
@@ -251,7 +246,7 @@ js_ByteArray_getProp(duk_context* ctx)
 	int          index;
 	int          size;
 
-	duk_get_prop_string(ctx, 0, "\xFF" "ptr"); array = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	array = duk_require_sphere_obj(ctx, 0, s_bytearray_type);
 	if (duk_is_number(ctx, 1)) {
 		index = duk_to_int(ctx, 1);
 		size = get_bytearray_size(array);
@@ -274,7 +269,7 @@ js_ByteArray_setProp(duk_context* ctx)
 	int          index;
 	int          size;
 
-	duk_get_prop_string(ctx, 0, "\xFF" "ptr"); array = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	array = duk_require_sphere_obj(ctx, 0, s_bytearray_type);
 	if (duk_is_number(ctx, 1)) {
 		index = duk_to_int(ctx, 1);
 		size = get_bytearray_size(array);
@@ -300,7 +295,7 @@ js_ByteArray_concat(duk_context* ctx)
 	bytearray_t* new_array;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); array = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	array = duk_require_sphere_obj(ctx, -1, s_bytearray_type);
 	duk_pop(ctx);
 	if (array->size + array2->size > INT_MAX)
 		duk_error_ni(ctx, -1, DUK_ERR_RANGE_ERROR, "ByteArray:concat(): Unable to concatenate, final size would exceed 2 GB (size1: %u, size2: %u)", array->size, array2->size);
@@ -322,7 +317,7 @@ js_ByteArray_slice(duk_context* ctx)
 	bytearray_t* new_array;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); array = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	array = duk_require_sphere_obj(ctx, -1, s_bytearray_type);
 	duk_pop(ctx);
 	end_norm = fmin(end >= 0 ? end : array->size + end, array->size);
 	if (end_norm < start || end_norm > array->size)
@@ -6,8 +6,23 @@ static duk_ret_t js_CreateColor         (duk_context* ctx);
 static duk_ret_t js_BlendColors         (duk_context* ctx);
 static duk_ret_t js_BlendColorsWeighted (duk_context* ctx);
 static duk_ret_t js_Color_toString      (duk_context* ctx);
+static duk_ret_t js_Color_get_red       (duk_context* ctx);
+static duk_ret_t js_Color_set_red       (duk_context* ctx);
+static duk_ret_t js_Color_get_green     (duk_context* ctx);
+static duk_ret_t js_Color_set_green     (duk_context* ctx);
+static duk_ret_t js_Color_get_blue      (duk_context* ctx);
+static duk_ret_t js_Color_set_blue      (duk_context* ctx);
+static duk_ret_t js_Color_get_alpha     (duk_context* ctx);
+static duk_ret_t js_Color_set_alpha     (duk_context* ctx);
 static duk_ret_t js_Color_clone         (duk_context* ctx);
 
+static duk_ret_t get_color_channel (duk_context* ctx, int shift);
+static duk_ret_t set_color_channel (duk_context* ctx, int shift);
+
+static int   s_color_type       = -1;
+static bool  s_have_float_table = false;
+static float s_u8_to_float[256];
+
 color_t
 rgba(uint8_t r, uint8_t g, uint8_t b, uint8_t alpha)
 {
@@ -23,7 +38,22 @@ rgba(uint8_t r, uint8_t g, uint8_t b, uint8_t alpha)
 ALLEGRO_COLOR
 nativecolor(color_t color)
 {
-	return al_map_rgba(color.r, color.g, color.b, color.alpha);
+	// this is called for nearly every draw. Allegro's own al_map_rgba() is a
+	// table lookup as well, but doing it here saves the library call.
+	ALLEGRO_COLOR native;
+	
+	int i;
+
+	if (!s_have_float_table) {
+		for (i = 0; i < 256; ++i)
+			s_u8_to_float[i] = i / 255.0f;
+		s_have_float_table = true;
+	}
+	native.r = s_u8_to_float[color.r];
+	native.g = s_u8_to_float[color.g];
+	native.b = s_u8_to_float[color.b];
+	native.a = s_u8_to_float[color.alpha];
+	return native;
 }
 
 color_t
@@ -46,24 +76,30 @@ init_color_api(void)
 	register_api_func(g_duktape, NULL, "CreateColor", js_CreateColor);
 	register_api_func(g_duktape, NULL, "BlendColors", js_BlendColors);
 	register_api_func(g_duktape, NULL, "BlendColorsWeighted", js_BlendColorsWeighted);
+	s_color_type = register_api_type(g_duktape, "Color", NULL);
+	register_api_prop(g_duktape, s_color_type, "red", js_Color_get_red, js_Color_set_red);
+	register_api_prop(g_duktape, s_color_type, "green", js_Color_get_green, js_Color_set_green);
+	register_api_prop(g_duktape, s_color_type, "blue", js_Color_get_blue, js_Color_set_blue);
+	register_api_prop(g_duktape, s_color_type, "alpha", js_Color_get_alpha, js_Color_set_alpha);
+	register_api_method(g_duktape, s_color_type, "toString", js_Color_toString);
+	register_api_method(g_duktape, s_color_type, "clone", js_Color_clone);
 }
 
 color_t
 duk_require_sphere_color(duk_context* ctx, duk_idx_t index)
 {
-	color_t     color;
-	const char* type;
+	color_t  color;
+	uint32_t value;
 	
 	index = duk_require_normalize_index(ctx, index);
 	duk_require_object_coercible(ctx, index);
-	if (!duk_get_prop_string(ctx, index, "\xFF" "sphere_type"))
+	if (!duk_get_prop_string(ctx, index, "\xFF" "rgba"))
 		goto on_error;
-	type = duk_get_string(ctx, -1); duk_pop(ctx);
-	if (strcmp(type, "color") != 0) goto on_error;
-	duk_get_prop_string(ctx, index, "red"); color.r = fmin(fmax(duk_get_number(ctx, -1), 0), 255); duk_pop(ctx);
-	duk_get_prop_string(ctx, index, "green"); color.g = fmin(fmax(duk_get_number(ctx, -1), 0), 255); duk_pop(ctx);
-	duk_get_prop_string(ctx, index, "blue"); color.b = fmin(fmax(duk_get_number(ctx, -1), 0), 255); duk_pop(ctx);
-	duk_get_prop_string(ctx, index, "alpha"); color.alpha = fmin(fmax(duk_get_number(ctx, -1), 0), 255); duk_pop(ctx);
+	value = duk_to_uint32(ctx, -1); duk_pop(ctx);
+	color.r = value >> 24;
+	color.g = value >> 16 & 0xFF;
+	color.b = value >> 8 & 0xFF;
+	color.alpha = value & 0xFF;
 	return color;
 
 on_error:
@@ -73,14 +109,40 @@ on_error:
 void
 duk_push_sphere_color(duk_context* ctx, color_t color)
 {
-	duk_push_object(ctx);
-	duk_push_string(ctx, "color"); duk_put_prop_string(ctx, -2, "\xFF" "sphere_type");
-	duk_push_c_function(ctx, js_Color_toString, DUK_VARARGS); duk_put_prop_string(ctx, -2, "toString");
-	duk_push_c_function(ctx, js_Color_clone, DUK_VARARGS); duk_put_prop_string(ctx, -2, "clone");
-	duk_push_number(ctx, color.r); duk_put_prop_string(ctx, -2, "red");
-	duk_push_number(ctx, color.g); duk_put_prop_string(ctx, -2, "green");
-	duk_push_number(ctx, color.b); duk_put_prop_string(ctx, -2, "blue");
-	duk_push_number(ctx, color.alpha); duk_put_prop_string(ctx, -2, "alpha");
+	uint32_t value;
+	
+	// color channels are packed into a single hidden value; red, green, blue and
+	// alpha are own accessors onto it. unlike the plain properties they replace,
+	// assigned values read back clamped to 0-255 and truncated to an integer.
+	value = (uint32_t)color.r << 24 | color.g << 16 | color.b << 8 | color.alpha;
+	duk_push_sphere_obj(ctx, s_color_type, NULL);
+	duk_push_uint(ctx, value); duk_put_prop_string(ctx, -2, "\xFF" "rgba");
+}
+
+static duk_ret_t
+get_color_channel(duk_context* ctx, int shift)
+{
+	uint32_t value;
+
+	duk_push_this(ctx);
+	duk_get_prop_string(ctx, -1, "\xFF" "rgba"); value = duk_to_uint32(ctx, -1); duk_pop_2(ctx);
+	duk_push_uint(ctx, value >> shift & 0xFF);
+	return 1;
+}
+
+static duk_ret_t
+set_color_channel(duk_context* ctx, int shift)
+{
+	uint32_t channel;
+	uint32_t value;
+	
+	channel = fmin(fmax(duk_to_number(ctx, 0), 0), 255);
+	duk_push_this(ctx);
+	duk_get_prop_string(ctx, -1, "\xFF" "rgba"); value = duk_to_uint32(ctx, -1); duk_pop(ctx);
+	value = (value & ~(0xFFU << shift)) | channel << shift;
+	duk_push_uint(ctx, value); duk_put_prop_string(ctx, -2, "\xFF" "rgba");
+	duk_pop(ctx);
+	return 0;
 }
 
 static duk_ret_t
@@ -131,6 +193,54 @@ js_Color_toString(duk_context* ctx)
 	return 1;
 }
 
+static duk_ret_t
+js_Color_get_red(duk_context* ctx)
+{
+	return get_color_channel(ctx, 24);
+}
+
+static duk_ret_t
+js_Color_set_red(duk_context* ctx)
+{
+	return set_color_channel(ctx, 24);
+}
+
+static duk_ret_t
+js_Color_get_green(duk_context* ctx)
+{
+	return get_color_channel(ctx, 16);
+}
+
+static duk_ret_t
+js_Color_set_green(duk_context* ctx)
+{
+	return set_color_channel(ctx, 16);
+}
+
+static duk_ret_t
+js_Color_get_blue(duk_context* ctx)
+{
+	return get_color_channel(ctx, 8);
+}
+
+static duk_ret_t
+js_Color_set_blue(duk_context* ctx)
+{
+	return set_color_channel(ctx, 8);
+}
+
+static duk_ret_t
+js_Color_get_alpha(duk_context* ctx)
+{
+	return get_color_channel(ctx, 0);
+}
+
+static duk_ret_t
+js_Color_set_alpha(duk_context* ctx)
+{
+	return set_color_channel(ctx, 0);
+}
+
 static duk_ret_t
 js_Color_clone(duk_context* ctx)
 {
@@ -16,27 +16,28 @@ static duk_ret_t js_File_write      (duk_context* ctx);
 
 static void duk_push_sphere_file (duk_context* ctx, ALLEGRO_CONFIG* conf, const char* path);
 
+static int s_file_type = -1;
+
 void
 init_file_api(void)
 {
 	register_api_func(g_duktape, NULL, "OpenFile", js_OpenFile);
 	register_api_func(g_duktape, NULL, "RemoveFile", js_RemoveFile);
+	s_file_type = register_api_type(g_duktape, "File", js_File_finalize);
+	register_api_method(g_duktape, s_file_type, "toString", js_File_toString);
+	register_api_method(g_duktape, s_file_type, "getKey", js_File_getKey);
+	register_api_method(g_duktape, s_file_type, "getNumKeys", js_File_getNumKeys);
+	register_api_method(g_duktape, s_file_type, "close", js_File_close);
+	register_api_method(g_duktape, s_file_type, "flush", js_File_flush);
+	register_api_method(g_duktape, s_file_type, "read", js_File_read);
+	register_api_method(g_duktape, s_file_type, "write", js_File_write);
 }
 
 static void
 duk_push_sphere_file(duk_context* ctx, ALLEGRO_CONFIG* conf, const char* path)
 {
-	duk_push_object(ctx);
-	duk_push_pointer(ctx, conf); duk_put_prop_string(ctx, -2, "\xFF" "conf_ptr");
+	duk_push_sphere_obj(ctx, s_file_type, conf);
 	duk_push_pointer(ctx, (void*)path); duk_put_prop_string(ctx, -2, "\xFF" "path");
-	duk_push_c_function(ctx, js_File_finalize, DUK_VARARGS); duk_set_finalizer(ctx, -2);
-	duk_push_c_function(ctx, js_File_toString, DUK_VARARGS); duk_put_prop_string(ctx, -2, "toString");
-	duk_push_c_function(ctx, js_File_getKey, DUK_VARARGS); duk_put_prop_string(ctx, -2, "getKey");
-	duk_push_c_function(ctx, js_File_getNumKeys, DUK_VARARGS); duk_put_prop_string(ctx, -2, "getNumKeys");
-	duk_push_c_function(ctx, js_File_close, DUK_VARARGS); duk_put_prop_string(ctx, -2, "close");
-	duk_push_c_function(ctx, js_File_flush, DUK_VARARGS); duk_put_prop_string(ctx, -2, "flush");
-	duk_push_c_function(ctx, js_File_read, DUK_VARARGS); duk_put_prop_string(ctx, -2, "read");
-	duk_push_c_function(ctx, js_File_write, DUK_VARARGS); duk_put_prop_string(ctx, -2, "write");
 }
 
 static duk_ret_t
@@ -85,7 +86,7 @@ js_File_finalize(duk_context* ctx)
 	ALLEGRO_CONFIG* conf;
 	const char*     path;
 
-	duk_get_prop_string(ctx, 0, "\xFF" "conf_ptr"); conf = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	conf = duk_require_sphere_obj(ctx, 0, s_file_type);
 	duk_get_prop_string(ctx, 0, "\xFF" "path"); path = duk_get_pointer(ctx, -1); duk_pop(ctx);
 	if (conf != NULL) al_save_config_file(path, conf);
 	return 0;
@@ -108,7 +109,7 @@ js_File_getKey(duk_context* ctx)
 	int                   i;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "conf_ptr"); conf = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	conf = duk_require_sphere_obj(ctx, -1, s_file_type);
 	duk_pop(ctx);
 	if (conf == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "File:getKey(): File has already been closed");
@@ -136,7 +137,7 @@ js_File_getNumKeys(duk_context* ctx)
 	const char*           key;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "conf_ptr"); conf = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	conf = duk_require_sphere_obj(ctx, -1, s_file_type);
 	duk_pop(ctx);
 	if (conf == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "File:getNumKeys(): File has already been closed");
@@ -157,7 +158,7 @@ js_File_flush (duk_context* ctx)
 	const char*     path;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "conf_ptr"); conf = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	conf = duk_require_sphere_obj(ctx, -1, s_file_type);
 	duk_get_prop_string(ctx, -1, "\xFF" "path"); path = duk_get_pointer(ctx, -1); duk_pop(ctx);
 	duk_pop(ctx);
 	if (conf == NULL)
@@ -173,14 +174,14 @@ js_File_close(duk_context* ctx)
 	const char*     path;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "conf_ptr"); conf = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	conf = duk_require_sphere_obj(ctx, -1, s_file_type);
 	duk_get_prop_string(ctx, -1, "\xFF" "path"); path = duk_get_pointer(ctx, -1); duk_pop(ctx);
 	duk_pop(ctx);
 	if (conf == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "File:close(): File has already been closed");
 	al_save_config_file(path, conf);
 	duk_push_this(ctx);
-	duk_push_pointer(ctx, NULL); duk_put_prop_string(ctx, -2, "\xFF" "conf_ptr");
+	duk_set_sphere_obj(ctx, -1, s_file_type, NULL);
 	duk_pop(ctx);
 	return 0;
 }
@@ -196,7 +197,7 @@ js_File_read(duk_context* ctx)
 	const char*     value_raw;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "conf_ptr"); conf = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	conf = duk_require_sphere_obj(ctx, -1, s_file_type);
 	duk_pop(ctx);
 	if (conf == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "File:read(): File has already been closed");
@@ -232,7 +233,7 @@ js_File_write(duk_context* ctx)
 	const char*     value_str;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "conf_ptr"); conf = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	conf = duk_require_sphere_obj(ctx, -1, s_file_type);
 	duk_pop(ctx);
 	if (conf == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "File:write(): File has already been closed");
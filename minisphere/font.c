@@ -63,13 +63,16 @@ struct rfn_glyph_header
 };
 #pragma pack(pop)
 
+static int s_font_type = -1;
+
 font_t*
 load_font(const char* path)
 {
 	image_t*                atlas = NULL;
 	int                     atlas_size_x, atlas_size_y;
 	ALLEGRO_LOCKED_REGION*  bitmap_lock;
-	FILE*                   file;
+	const uint8_t*          data;
+	memfile_t*              file = NULL;
 	font_t*                 font = NULL;
 	struct font_glyph*      glyph;
 	struct rfn_glyph_header glyph_hdr;
@@ -79,27 +82,29 @@ load_font(const char* path)
 	int64_t                 n_glyphs_per_row;
 	size_t                  pixel_size;
 	struct rfn_header       rfn;
-	uint8_t                 *src_ptr, *dest_ptr;
+	const uint8_t           *src_ptr;
+	uint8_t                 *dest_ptr;
 
 	int i, x, y;
 
 	memset(&rfn, 0, sizeof(struct rfn_header));
 
-	if ((file = fopen(path, "rb")) == NULL) goto on_error;
+	if ((file = open_memfile(path)) == NULL) goto on_error;
 	if (!(font = calloc(1, sizeof(font_t)))) goto on_error;
-	if (fread(&rfn, sizeof(struct rfn_header), 1, file) != 1)
+	if (!read_memfile(file, &rfn, sizeof(struct rfn_header)))
 		goto on_error;
 	pixel_size = (rfn.version == 1) ? 1 : 4;
 	if (!(font->glyphs = calloc(rfn.num_chars, sizeof(struct font_glyph))))
 		goto on_error;
 
 	// pass 1: load glyph headers and find largest glyph
-	glyph_start = ftell(file);
+	glyph_start = tell_memfile(file);
 	for (i = 0; i < rfn.num_chars; ++i) {
 		glyph = &font->glyphs[i];
-		if (fread(&glyph_hdr, sizeof(struct rfn_glyph_header), 1, file) != 1)
+		if (!read_memfile(file, &glyph_hdr, sizeof(struct rfn_glyph_header)))
+			goto on_error;
+		if (!seek_memfile(file, glyph_hdr.width * glyph_hdr.height * pixel_size, SEEK_CUR))
 			goto on_error;
-		fseek(file, glyph_hdr.width * glyph_hdr.height * pixel_size, SEEK_CUR);
 		max_x = fmax(glyph_hdr.width, max_x);
 		max_y = fmax(glyph_hdr.height, max_y);
 		min_width = fmin(min_width, glyph_hdr.width);
@@ -118,14 +123,13 @@ load_font(const char* path)
 		goto on_error;
 
 	// pass 2: load glyph data
-	fseek(file, glyph_start, SEEK_SET);
+	seek_memfile(file, glyph_start, SEEK_SET);
 	for (i = 0; i < rfn.num_chars; ++i) {
 		glyph = &font->glyphs[i];
-		if (fread(&glyph_hdr, sizeof(struct rfn_glyph_header), 1, file) != 1)
+		if (!read_memfile(file, &glyph_hdr, sizeof(struct rfn_glyph_header)))
+			goto on_error;
+		if (!(data = read_memfile_ptr(file, glyph_hdr.width * glyph_hdr.height * pixel_size)))
 			goto on_error;
-		size_t data_size = glyph_hdr.width * glyph_hdr.height * pixel_size;
-		void* data = malloc(data_size);
-		if (fread(data, 1, data_size, file) != data_size) goto on_error;
 		glyph->image = create_subimage(atlas,
 			i % n_glyphs_per_row * max_x, i / n_glyphs_per_row * max_y,
 			glyph_hdr.width, glyph_hdr.height);
@@ -156,13 +160,13 @@ load_font(const char* path)
 			break;
 		}
 		al_unlock_bitmap(get_image_bitmap(glyph->image));
-		free(data);
 	}
-	fclose(file);
+	close_memfile(file);
 	free_image(atlas);
 	return ref_font(font);
 
 on_error:
+	close_memfile(file);
 	if (font != NULL) {
 		for (i = 0; i < rfn.num_chars; ++i) {
 			if (font->glyphs[i].image != NULL) free_image(font->glyphs[i].image);
@@ -345,6 +349,20 @@ init_font_api(duk_context* ctx)
 {
 	register_api_func(ctx, NULL, "GetSystemFont", js_GetSystemFont);
 	register_api_func(ctx, NULL, "LoadFont", js_LoadFont);
+	s_font_type = register_api_type(ctx, "Font", js_Font_finalize);
+	register_api_method(ctx, s_font_type, "toString", js_Font_toString);
+	register_api_method(ctx, s_font_type, "clone", js_Font_clone);
+	register_api_method(ctx, s_font_type, "getCharacterImage", js_Font_getCharacterImage);
+	register_api_method(ctx, s_font_type, "getColorMask", js_Font_getColorMask);
+	register_api_method(ctx, s_font_type, "getHeight", js_Font_getHeight);
+	register_api_method(ctx, s_font_type, "setCharacterImage", js_Font_setCharacterImage);
+	register_api_method(ctx, s_font_type, "setColorMask", js_Font_setColorMask);
+	register_api_method(ctx, s_font_type, "drawText", js_Font_drawText);
+	register_api_method(ctx, s_font_type, "drawTextBox", js_Font_drawTextBox);
+	register_api_method(ctx, s_font_type, "drawZoomedText", js_Font_drawZoomedText);
+	register_api_method(ctx, s_font_type, "getStringHeight", js_Font_getStringHeight);
+	register_api_method(ctx, s_font_type, "getStringWidth", js_Font_getStringWidth);
+	register_api_method(ctx, s_font_type, "wordWrapString", js_Font_wordWrapString);
 }
 
 void
@@ -352,44 +370,15 @@ duk_push_sphere_font(duk_context* ctx, font_t* font)
 {
 	ref_font(font);
 	
-	duk_push_object(ctx);
-	duk_push_c_function(ctx, js_Font_finalize, DUK_VARARGS); duk_set_finalizer(ctx, -2);
-	duk_push_c_function(ctx, js_Font_toString, DUK_VARARGS); duk_put_prop_string(ctx, -2, "toString");
-	duk_push_c_function(ctx, js_Font_clone, DUK_VARARGS); duk_put_prop_string(ctx, -2, "clone");
-	duk_push_c_function(ctx, js_Font_getCharacterImage, DUK_VARARGS); duk_put_prop_string(ctx, -2, "getCharacterImage");
-	duk_push_c_function(ctx, js_Font_getColorMask, DUK_VARARGS); duk_put_prop_string(ctx, -2, "getColorMask");
-	duk_push_c_function(ctx, js_Font_getHeight, DUK_VARARGS); duk_put_prop_string(ctx, -2, "getHeight");
-	duk_push_c_function(ctx, js_Font_setCharacterImage, DUK_VARARGS); duk_put_prop_string(ctx, -2, "setCharacterImage");
-	duk_push_c_function(ctx, js_Font_setColorMask, DUK_VARARGS); duk_put_prop_string(ctx, -2, "setColorMask");
-	duk_push_c_function(ctx, js_Font_drawText, DUK_VARARGS); duk_put_prop_string(ctx, -2, "drawText");
-	duk_push_c_function(ctx, js_Font_drawTextBox, DUK_VARARGS); duk_put_prop_string(ctx, -2, "drawTextBox");
-	duk_push_c_function(ctx, js_Font_drawZoomedText, DUK_VARARGS); duk_put_prop_string(ctx, -2, "drawZoomedText");
-	duk_push_c_function(ctx, js_Font_getStringHeight, DUK_VARARGS); duk_put_prop_string(ctx, -2, "getStringHeight");
-	duk_push_c_function(ctx, js_Font_getStringWidth, DUK_VARARGS); duk_put_prop_string(ctx, -2, "getStringWidth");
-	duk_push_c_function(ctx, js_Font_wordWrapString, DUK_VARARGS); duk_put_prop_string(ctx, -2, "wordWrapString");
+	duk_push_sphere_obj(ctx, s_font_type, font);
 	
-	duk_push_string(ctx, "font"); duk_put_prop_string(ctx, -2, "\xFF" "sphere_type");
-	duk_push_pointer(ctx, font); duk_put_prop_string(ctx, -2, "\xFF" "ptr");
 	duk_push_sphere_color(ctx, rgba(255, 255, 255, 255)); duk_put_prop_string(ctx, -2, "\xFF" "color_mask");
 }
 
 font_t*
 duk_require_sphere_font(duk_context* ctx, duk_idx_t index)
 {
-	font_t*     font;
-	const char* type;
-
-	index = duk_require_normalize_index(ctx, index);
-	duk_require_object_coercible(ctx, index);
-	if (!duk_get_prop_string(ctx, index, "\xFF" "sphere_type"))
-		goto on_error;
-	type = duk_get_string(ctx, -1); duk_pop(ctx);
-	if (strcmp(type, "font") != 0) goto on_error;
-	duk_get_prop_string(ctx, index, "\xFF" "ptr"); font = duk_get_pointer(ctx, -1); duk_pop(ctx);
-	return font;
-
-on_error:
-	duk_error_ni(ctx, -1, DUK_ERR_TYPE_ERROR, "Object is not a Sphere font");
+	return duk_require_sphere_obj(ctx, index, s_font_type);
 }
 
 static duk_ret_t
@@ -421,7 +410,7 @@ js_Font_finalize(duk_context* ctx)
 {
 	font_t* font;
 
-	duk_get_prop_string(ctx, 0, "\xFF" "ptr"); font = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	font = duk_require_sphere_obj(ctx, 0, s_font_type);
 	free_font(font);
 	return 0;
 }
@@ -439,7 +428,7 @@ js_Font_clone(duk_context* ctx)
 	font_t* font;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); font = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	font = duk_require_sphere_obj(ctx, -1, s_font_type);
 	duk_pop(ctx);
 	// TODO: actually clone font in Font:clone()
 	duk_push_sphere_font(ctx, font);
@@ -454,7 +443,7 @@ js_Font_getCharacterImage(duk_context* ctx)
 	font_t* font;
 	
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); font = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	font = duk_require_sphere_obj(ctx, -1, s_font_type);
 	duk_pop(ctx);
 	duk_push_sphere_image(ctx, get_glyph_image(font, cp));
 	return 1;
@@ -475,7 +464,7 @@ js_Font_getHeight(duk_context* ctx)
 	font_t* font;
 	
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); font = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	font = duk_require_sphere_obj(ctx, -1, s_font_type);
 	duk_pop(ctx);
 	duk_push_int(ctx, get_font_line_height(font));
 	return 1;
@@ -490,7 +479,7 @@ js_Font_setCharacterImage(duk_context* ctx)
 	font_t* font;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); font = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	font = duk_require_sphere_obj(ctx, -1, s_font_type);
 	duk_pop(ctx);
 	set_glyph_image(font, cp, image);
 	return 0;
@@ -502,7 +491,7 @@ js_Font_setColorMask(duk_context* ctx)
 	font_t* font;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); font = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	font = duk_require_sphere_obj(ctx, -1, s_font_type);
 	duk_dup(ctx, 0); duk_put_prop_string(ctx, -2, "\xFF" "color_mask"); duk_pop(ctx);
 	duk_pop(ctx);
 	return 0;
@@ -519,7 +508,7 @@ js_Font_drawText(duk_context* ctx)
 	color_t mask;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); font = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	font = duk_require_sphere_obj(ctx, -1, s_font_type);
 	duk_get_prop_string(ctx, -1, "\xFF" "color_mask"); mask = duk_require_sphere_color(ctx, -1); duk_pop(ctx);
 	duk_pop(ctx);
 	if (!is_skipped_frame()) draw_text(font, mask, x, y, TEXT_ALIGN_LEFT, text);
@@ -540,7 +529,7 @@ js_Font_drawZoomedText(duk_context* ctx)
 	int             text_w, text_h;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); font = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	font = duk_require_sphere_obj(ctx, -1, s_font_type);
 	duk_get_prop_string(ctx, -1, "\xFF" "color_mask"); mask = duk_require_sphere_color(ctx, -1); duk_pop(ctx);
 	duk_pop(ctx);
 	if (!is_skipped_frame()) {
@@ -575,7 +564,7 @@ js_Font_drawTextBox(duk_context* ctx)
 	int i;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); font = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	font = duk_require_sphere_obj(ctx, -1, s_font_type);
 	duk_get_prop_string(ctx, -1, "\xFF" "color_mask"); mask = duk_require_sphere_color(ctx, -1); duk_pop(ctx);
 	duk_pop(ctx);
 	if (!is_skipped_frame()) {
@@ -606,7 +595,7 @@ js_Font_getStringHeight(duk_context* ctx)
 	int     num_lines;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); font = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	font = duk_require_sphere_obj(ctx, -1, s_font_type);
 	duk_pop(ctx);
 	duk_push_c_function(ctx, js_Font_wordWrapString, DUK_VARARGS);
 	duk_push_this(ctx);
@@ -627,7 +616,7 @@ js_Font_getStringWidth(duk_context* ctx)
 	font_t* font;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); font = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	font = duk_require_sphere_obj(ctx, -1, s_font_type);
 	duk_pop(ctx);
 	duk_push_int(ctx, get_text_width(font, text));
 	return 1;
@@ -646,7 +635,7 @@ js_Font_wordWrapString(duk_context* ctx)
 	int i;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); font = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	font = duk_require_sphere_obj(ctx, -1, s_font_type);
 	duk_pop(ctx);
 	wraptext = word_wrap_text(font, text, width);
 	num_lines = get_wraptext_line_count(wraptext);
@@ -14,6 +14,45 @@ new_rect(int x1, int y1, int x2, int y2)
 	return rectangle;
 }
 
+bool
+clip_line(rect_t* inout_line, rect_t bounds)
+{
+	// Liang-Barsky. bounds are exclusive on the right and bottom, like a rect
+	// passed to is_point_in_rect(). returns false if no part of the line is inside.
+	double dx, dy;
+	double p[4], q[4];
+	double t, t1, t2;
+	
+	int i;
+
+	dx = inout_line->x2 - inout_line->x1;
+	dy = inout_line->y2 - inout_line->y1;
+	p[0] = -dx; q[0] = inout_line->x1 - bounds.x1;
+	p[1] = dx;  q[1] = bounds.x2 - 1 - inout_line->x1;
+	p[2] = -dy; q[2] = inout_line->y1 - bounds.y1;
+	p[3] = dy;  q[3] = bounds.y2 - 1 - inout_line->y1;
+	t1 = 0.0; t2 = 1.0;
+	for (i = 0; i < 4; ++i) {
+		if (p[i] == 0.0) {
+			if (q[i] < 0.0) return false;
+			continue;
+		}
+		t = q[i] / p[i];
+		if (p[i] < 0.0) {
+			if (t > t2) return false;
+			if (t > t1) t1 = t;
+		}
+		else {
+			if (t < t1) return false;
+			if (t < t2) t2 = t;
+		}
+	}
+	*inout_line = new_rect(
+		floor(inout_line->x1 + t1 * dx + 0.5), floor(inout_line->y1 + t1 * dy + 0.5),
+		floor(inout_line->x1 + t2 * dx + 0.5), floor(inout_line->y1 + t2 * dy + 0.5));
+	return true;
+}
+
 bool
 do_lines_intersect(rect_t a, rect_t b)
 {
@@ -65,29 +104,23 @@ zoom_rect(rect_t rect, double scale_x, double scale_y)
 }
 
 bool
-fread_rect_16(FILE* file, rect_t* out_rect)
+read_rect_16(memfile_t* file, rect_t* out_rect)
 {
-	int16_t x1, y1, x2, y2;
+	int16_t coords[4];
 
-	if (fread(&x1, 2, 1, file) != 1) return false;
-	if (fread(&y1, 2, 1, file) != 1) return false;
-	if (fread(&x2, 2, 1, file) != 1) return false;
-	if (fread(&y2, 2, 1, file) != 1) return false;
-	out_rect->x1 = x1; out_rect->y1 = y1;
-	out_rect->x2 = x2; out_rect->y2 = y2;
+	if (!read_memfile(file, coords, sizeof(coords))) return false;
+	out_rect->x1 = coords[0]; out_rect->y1 = coords[1];
+	out_rect->x2 = coords[2]; out_rect->y2 = coords[3];
 	return true;
 }
 
 bool
-fread_rect_32(FILE* file, rect_t* out_rect)
+read_rect_32(memfile_t* file, rect_t* out_rect)
 {
-	int32_t x1, y1, x2, y2;
+	int32_t coords[4];
 
-	if (fread(&x1, 4, 1, file) != 1) return false;
-	if (fread(&y1, 4, 1, file) != 1) return false;
-	if (fread(&x2, 4, 1, file) != 1) return false;
-	if (fread(&y2, 4, 1, file) != 1) return false;
-	out_rect->x1 = x1; out_rect->y1 = y1;
-	out_rect->x2 = x2; out_rect->y2 = y2;
+	if (!read_memfile(file, coords, sizeof(coords))) return false;
+	out_rect->x1 = coords[0]; out_rect->y1 = coords[1];
+	out_rect->x2 = coords[2]; out_rect->y2 = coords[3];
 	return true;
 }
@@ -12,6 +12,7 @@ struct image
 	int             width;
 	int             height;
 	image_t*        parent;
+	void*           heapptr;
 };
 
 static duk_ret_t js_GetSystemArrow           (duk_context* ctx);
@@ -31,6 +32,7 @@ static duk_ret_t js_Image_transformBlitMask  (duk_context* ctx);
 static duk_ret_t js_Image_zoomBlit           (duk_context* ctx);
 static duk_ret_t js_Image_zoomBlitMask       (duk_context* ctx);
 
+static int      s_image_type   = -1;
 static image_t* s_sys_arrow    = NULL;
 static image_t* s_sys_dn_arrow = NULL;
 static image_t* s_sys_up_arrow = NULL;
@@ -108,26 +110,27 @@ on_error:
 }
 
 image_t*
-read_image(FILE* file, int width, int height)
+read_image(memfile_t* file, int width, int height)
 {
 	long                   file_pos;
-	image_t*               image;
+	image_t*               image = NULL;
 	uint8_t*               line_ptr;
 	size_t                 line_size;
 	ALLEGRO_LOCKED_REGION* lock = NULL;
+	const uint8_t*         pixels;
 
 	int i_y;
 
-	file_pos = ftell(file);
+	file_pos = tell_memfile(file);
+	line_size = width * 4;
+	if (!(pixels = read_memfile_ptr(file, line_size * height))) goto on_error;
 	if ((image = calloc(1, sizeof(image_t))) == NULL) goto on_error;
 	if ((image->bitmap = al_create_bitmap(width, height)) == NULL) goto on_error;
 	if ((lock = al_lock_bitmap(image->bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888, ALLEGRO_LOCK_WRITEONLY)) == NULL)
 		goto on_error;
-	line_size = width * 4;
 	for (i_y = 0; i_y < height; ++i_y) {
 		line_ptr = (uint8_t*)lock->data + i_y * lock->pitch;
-		if (fread(line_ptr, line_size, 1, file) != 1)
-			goto on_error;
+		memcpy(line_ptr, pixels + i_y * line_size, line_size);
 	}
 	al_unlock_bitmap(image->bitmap);
 	image->width = al_get_bitmap_width(image->bitmap);
@@ -135,8 +138,7 @@ read_image(FILE* file, int width, int height)
 	return ref_image(image);
 
 on_error:
-	fseek(file, file_pos, SEEK_SET);
-	if (lock != NULL) al_unlock_bitmap(image->bitmap);
+	seek_memfile(file, file_pos, SEEK_SET);
 	if (image != NULL) {
 		if (image->bitmap != NULL) al_destroy_bitmap(image->bitmap);
 		free(image);
@@ -145,32 +147,32 @@ on_error:
 }
 
 image_t*
-read_subimage(FILE* file, image_t* parent, int x, int y, int width, int height)
+read_subimage(memfile_t* file, image_t* parent, int x, int y, int width, int height)
 {
 	long                   file_pos;
-	image_t*               image;
+	image_t*               image = NULL;
 	uint8_t*               line_ptr;
 	size_t                 line_size;
 	ALLEGRO_LOCKED_REGION* lock = NULL;
+	const uint8_t*         pixels;
 
 	int i_y;
 
-	file_pos = ftell(file);
+	file_pos = tell_memfile(file);
+	line_size = width * 4;
+	if (!(pixels = read_memfile_ptr(file, line_size * height))) goto on_error;
 	if (!(image = create_subimage(parent, x, y, width, height))) goto on_error;
 	if ((lock = al_lock_bitmap(image->bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888, ALLEGRO_LOCK_WRITEONLY)) == NULL)
 		goto on_error;
-	line_size = width * 4;
 	for (i_y = 0; i_y < height; ++i_y) {
 		line_ptr = (uint8_t*)lock->data + i_y * lock->pitch;
-		if (fread(line_ptr, line_size, 1, file) != 1)
-			goto on_error;
+		memcpy(line_ptr, pixels + i_y * line_size, line_size);
 	}
 	al_unlock_bitmap(image->bitmap);
 	return image;
 
 on_error:
-	fseek(file, file_pos, SEEK_SET);
-	if (lock != NULL) al_unlock_bitmap(image->bitmap);
+	seek_memfile(file, file_pos, SEEK_SET);
 	free_image(image);
 	return NULL;
 }
@@ -241,7 +243,7 @@ draw_image(image_t* image, int x, int y)
 void
 draw_image_masked(image_t* image, color_t mask, int x, int y)
 {
-	al_draw_tinted_bitmap(image->bitmap, al_map_rgba(mask.r, mask.g, mask.b, mask.alpha), x, y, 0x0);
+	al_draw_tinted_bitmap(image->bitmap, nativecolor(mask), x, y, 0x0);
 }
 
 void
@@ -290,7 +292,7 @@ fill_image(image_t* image, color_t color)
 	al_reset_clipping_rectangle();
 	last_target = al_get_target_bitmap();
 	al_set_target_bitmap(image->bitmap);
-	al_clear_to_color(al_map_rgba(color.r, color.g, color.b, color.alpha));
+	al_clear_to_color(nativecolor(color));
 	al_set_target_bitmap(last_target);
 	al_set_clipping_rectangle(clip_x, clip_y, clip_w, clip_h);
 }
@@ -364,27 +366,32 @@ init_image_api(duk_context* ctx)
 	register_api_func(ctx, NULL, "GetSystemUpArrow", js_GetSystemUpArrow);
 	register_api_func(ctx, NULL, "LoadImage", js_LoadImage);
 	register_api_func(ctx, NULL, "GrabImage", js_GrabImage);
+	s_image_type = register_api_type(ctx, "Image", js_Image_finalize);
+	register_api_method(ctx, s_image_type, "toString", js_Image_toString);
+	register_api_method(ctx, s_image_type, "blit", js_Image_blit);
+	register_api_method(ctx, s_image_type, "blitMask", js_Image_blitMask);
+	register_api_method(ctx, s_image_type, "createSurface", js_Image_createSurface);
+	register_api_method(ctx, s_image_type, "rotateBlit", js_Image_rotateBlit);
+	register_api_method(ctx, s_image_type, "rotateBlitMask", js_Image_rotateBlitMask);
+	register_api_method(ctx, s_image_type, "transformBlit", js_Image_transformBlit);
+	register_api_method(ctx, s_image_type, "transformBlitMask", js_Image_transformBlitMask);
+	register_api_method(ctx, s_image_type, "zoomBlit", js_Image_zoomBlit);
+	register_api_method(ctx, s_image_type, "zoomBlitMask", js_Image_zoomBlitMask);
 }
 
 void
 duk_push_sphere_image(duk_context* ctx, image_t* image)
 {
+	// images are often requested again and again (GetTileImage(), Spriteset:images
+	// and so on), so each one keeps a weak pointer to its JS wrapper and reuses it.
+	// the finalizer clears the pointer before the wrapper goes away.
+	if (image->heapptr != NULL) {
+		duk_push_heapptr(ctx, image->heapptr);
+		return;
+	}
+	
 	ref_image(image);
-
-	duk_push_object(ctx);
-	duk_push_string(ctx, "image"); duk_put_prop_string(ctx, -2, "\xFF" "sphere_type");
-	duk_push_pointer(ctx, image); duk_put_prop_string(ctx, -2, "\xFF" "ptr");
-	duk_push_c_function(ctx, js_Image_finalize, DUK_VARARGS); duk_set_finalizer(ctx, -2);
-	duk_push_c_function(ctx, js_Image_toString, DUK_VARARGS); duk_put_prop_string(ctx, -2, "toString");
-	duk_push_c_function(ctx, js_Image_blit, DUK_VARARGS); duk_put_prop_string(ctx, -2, "blit");
-	duk_push_c_function(ctx, js_Image_blitMask, DUK_VARARGS); duk_put_prop_string(ctx, -2, "blitMask");
-	duk_push_c_function(ctx, js_Image_createSurface, DUK_VARARGS); duk_put_prop_string(ctx, -2, "createSurface");
-	duk_push_c_function(ctx, js_Image_rotateBlit, DUK_VARARGS); duk_put_prop_string(ctx, -2, "rotateBlit");
-	duk_push_c_function(ctx, js_Image_rotateBlitMask, DUK_VARARGS); duk_put_prop_string(ctx, -2, "rotateBlitMask");
-	duk_push_c_function(ctx, js_Image_transformBlit, DUK_VARARGS); duk_put_prop_string(ctx, -2, "transformBlit");
-	duk_push_c_function(ctx, js_Image_transformBlitMask, DUK_VARARGS); duk_put_prop_string(ctx, -2, "transformBlitMask");
-	duk_push_c_function(ctx, js_Image_zoomBlit, DUK_VARARGS); duk_put_prop_string(ctx, -2, "zoomBlit");
-	duk_push_c_function(ctx, js_Image_zoomBlitMask, DUK_VARARGS); duk_put_prop_string(ctx, -2, "zoomBlitMask");
+	duk_push_sphere_obj(ctx, s_image_type, image);
 	duk_push_string(ctx, "width"); duk_push_int(ctx, get_image_width(image));
 	duk_def_prop(ctx, -3,
 		DUK_DEFPROP_HAVE_CONFIGURABLE | 0
@@ -395,26 +402,13 @@ duk_push_sphere_image(duk_context* ctx, image_t* image)
 		DUK_DEFPROP_HAVE_CONFIGURABLE | 0
 		| DUK_DEFPROP_HAVE_WRITABLE | 0
 		| DUK_DEFPROP_HAVE_VALUE);
+	image->heapptr = duk_get_heapptr(ctx, -1);
 }
 
 image_t*
 duk_require_sphere_image(duk_context* ctx, duk_idx_t index)
 {
-	image_t*    image;
-	const char* type;
-
-	index = duk_require_normalize_index(ctx, index);
-	duk_require_object_coercible(ctx, index);
-	if (!duk_get_prop_string(ctx, index, "\xFF" "sphere_type"))
-		goto on_error;
-	type = duk_get_string(ctx, -1); duk_pop(ctx);
-	if (strcmp(type, "image") != 0) goto on_error;
-	duk_get_prop_string(ctx, index, "\xFF" "ptr");
-	image = duk_get_pointer(ctx, -1); duk_pop(ctx);
-	return image;
-
-on_error:
-	duk_error_ni(ctx, -1, DUK_ERR_TYPE_ERROR, "Object is not a Sphere image");
+	return duk_require_sphere_obj(ctx, index, s_image_type);
 }
 
 static duk_ret_t
@@ -491,7 +485,9 @@ js_Image_finalize(duk_context* ctx)
 {
 	image_t* image;
 
-	duk_get_prop_string(ctx, 0, "\xFF" "ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, 0, s_image_type);
+	if (image->heapptr == duk_get_heapptr(ctx, 0))
+		image->heapptr = NULL;
 	free_image(image);
 	return 0;
 }
@@ -512,7 +508,7 @@ js_Image_blit(duk_context* ctx)
 	image_t* image;
 	
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_image_type);
 	duk_pop(ctx);
 	if (!is_skipped_frame()) al_draw_bitmap(get_image_bitmap(image), x, y, 0x0);
 	return 0;
@@ -528,9 +524,9 @@ js_Image_blitMask(duk_context* ctx)
 	image_t* image;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_image_type);
 	duk_pop(ctx);
-	if (!is_skipped_frame()) al_draw_tinted_bitmap(get_image_bitmap(image), al_map_rgba(mask.r, mask.g, mask.b, mask.alpha), x, y, 0x0);
+	if (!is_skipped_frame()) al_draw_tinted_bitmap(get_image_bitmap(image), nativecolor(mask), x, y, 0x0);
 	return 0;
 }
 
@@ -541,7 +537,7 @@ js_Image_createSurface(duk_context* ctx)
 	image_t* new_image;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_image_type);
 	duk_pop(ctx);
 	if ((new_image = clone_image(image)) == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "Image:createSurface(): Failed to create new surface image");
@@ -560,7 +556,7 @@ js_Image_rotateBlit(duk_context* ctx)
 	image_t* image;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_image_type);
 	duk_pop(ctx);
 	if (!is_skipped_frame())
 		al_draw_rotated_bitmap(get_image_bitmap(image), image->width / 2, image->height / 2, x, y, angle, 0x0);
@@ -578,10 +574,10 @@ js_Image_rotateBlitMask(duk_context* ctx)
 	image_t* image;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_image_type);
 	duk_pop(ctx);
 	if (!is_skipped_frame())
-		al_draw_tinted_rotated_bitmap(get_image_bitmap(image), al_map_rgba(mask.r, mask.g, mask.b, mask.alpha),
+		al_draw_tinted_rotated_bitmap(get_image_bitmap(image), nativecolor(mask),
 			image->width / 2, image->height / 2, x, y, angle, 0x0);
 	return 0;
 }
@@ -602,7 +598,7 @@ js_Image_transformBlit(duk_context* ctx)
 	ALLEGRO_COLOR vertex_color;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_image_type);
 	duk_pop(ctx);
 	vertex_color = al_map_rgba(255, 255, 255, 255);
 	ALLEGRO_VERTEX v[] = {
@@ -633,9 +629,9 @@ js_Image_transformBlitMask(duk_context* ctx)
 	image_t*      image;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_image_type);
 	duk_pop(ctx);
-	vtx_color = al_map_rgba(mask.r, mask.g, mask.b, mask.alpha);
+	vtx_color = nativecolor(mask);
 	ALLEGRO_VERTEX v[] = {
 		{ x1, y1, 0, 0, 0, vtx_color },
 		{ x2, y2, 0, image->width, 0, vtx_color },
@@ -657,7 +653,7 @@ js_Image_zoomBlit(duk_context* ctx)
 	image_t* image;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_image_type);
 	duk_pop(ctx);
 	if (!is_skipped_frame())
 		al_draw_scaled_bitmap(get_image_bitmap(image), 0, 0, image->width, image->height, x, y, image->width * scale, image->height * scale, 0x0);
@@ -675,10 +671,10 @@ js_Image_zoomBlitMask(duk_context* ctx)
 	image_t* image;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_image_type);
 	duk_pop(ctx);
 	if (!is_skipped_frame())
-		al_draw_tinted_scaled_bitmap(get_image_bitmap(image), al_map_rgba(mask.r, mask.g, mask.b, mask.alpha),
+		al_draw_tinted_scaled_bitmap(get_image_bitmap(image), nativecolor(mask),
 			0, 0, image->width, image->height, x, y, image->width * scale, image->height * scale, 0x0);
 	return 0;
 }
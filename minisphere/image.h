@@ -1,14 +1,16 @@
 #ifndef MINISPHERE__IMAGE_H__INCLUDED
 #define MINISPHERE__IMAGE_H__INCLUDED
 
+#include "memfile.h"
+
 typedef struct image image_t;
 
 extern image_t*        create_image             (int width, int height);
 extern image_t*        create_subimage          (image_t* parent, int x, int y, int width, int height);
 extern image_t*        clone_image              (const image_t* image);
 extern image_t*        load_image               (const char* path);
-extern image_t*        read_image               (FILE* file, int width, int height);
-extern image_t*        read_subimage            (FILE* file, image_t* parent, int x, int y, int width, int height);
+extern image_t*        read_image               (memfile_t* file, int width, int height);
+extern image_t*        read_subimage            (memfile_t* file, image_t* parent, int x, int y, int width, int height);
 extern image_t*        ref_image                (image_t* image);
 extern void            free_image               (image_t* image);
 extern ALLEGRO_BITMAP* get_image_bitmap         (const image_t* image);
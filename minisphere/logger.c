@@ -25,6 +25,8 @@ static duk_ret_t js_Logger_beginBlock (duk_context* ctx);
 static duk_ret_t js_Logger_endBlock   (duk_context* ctx);
 static duk_ret_t js_Logger_write      (duk_context* ctx);
 
+static int s_logger_type = -1;
+
 logger_t*
 open_log_file(const char* path)
 {
@@ -127,6 +129,11 @@ void
 init_logging_api(void)
 {
 	register_api_func(g_duktape, NULL, "OpenLog", js_OpenLog);
+	s_logger_type = register_api_type(g_duktape, "Logger", js_Logger_finalize);
+	register_api_method(g_duktape, s_logger_type, "toString", js_Logger_toString);
+	register_api_method(g_duktape, s_logger_type, "beginBlock", js_Logger_beginBlock);
+	register_api_method(g_duktape, s_logger_type, "endBlock", js_Logger_endBlock);
+	register_api_method(g_duktape, s_logger_type, "write", js_Logger_write);
 }
 
 void
@@ -134,13 +141,7 @@ duk_push_sphere_logger(duk_context* ctx, logger_t* logger)
 {
 	ref_logger(logger);
 	
-	duk_push_object(ctx);
-	duk_push_pointer(ctx, logger); duk_put_prop_string(ctx, -2, "\xFF" "ptr");
-	duk_push_c_function(ctx, js_Logger_finalize, DUK_VARARGS); duk_set_finalizer(ctx, -2);
-	duk_push_c_function(ctx, js_Logger_toString, DUK_VARARGS); duk_put_prop_string(ctx, -2, "toString");
-	duk_push_c_function(ctx, js_Logger_beginBlock, DUK_VARARGS); duk_put_prop_string(ctx, -2, "beginBlock");
-	duk_push_c_function(ctx, js_Logger_endBlock, DUK_VARARGS); duk_put_prop_string(ctx, -2, "endBlock");
-	duk_push_c_function(ctx, js_Logger_write, DUK_VARARGS); duk_put_prop_string(ctx, -2, "write");
+	duk_push_sphere_obj(ctx, s_logger_type, logger);
 }
 
 static duk_ret_t
@@ -163,7 +164,7 @@ js_Logger_finalize(duk_context* ctx)
 {
 	logger_t* logger;
 
-	duk_get_prop_string(ctx, 0, "\xFF" "ptr"); logger = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	logger = duk_require_sphere_obj(ctx, 0, s_logger_type);
 	free_logger(logger);
 	return 0;
 }
@@ -183,7 +184,7 @@ js_Logger_beginBlock(duk_context* ctx)
 	logger_t* logger;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); logger = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	logger = duk_require_sphere_obj(ctx, -1, s_logger_type);
 	if (!begin_log_block(logger, title))
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "Log:beginBlock(): Failed to create new log block (internal error)");
 	return 0;
@@ -195,7 +196,7 @@ js_Logger_endBlock(duk_context* ctx)
 	logger_t* logger;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); logger = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	logger = duk_require_sphere_obj(ctx, -1, s_logger_type);
 	end_log_block(logger);
 	return 0;
 }
@@ -208,7 +209,7 @@ js_Logger_write(duk_context* ctx)
 	logger_t* logger;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); logger = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	logger = duk_require_sphere_obj(ctx, -1, s_logger_type);
 	write_log_line(logger, NULL, text);
 	return 0;
 }
@@ -60,37 +60,40 @@ clone_lstring(const lstring_t* string)
 }
 
 lstring_t*
-read_lstring(FILE* file, bool trim_null)
+read_lstring(memfile_t* file, bool trim_null)
 {
-	long     file_pos;
-	uint16_t length;
+	long       file_pos;
+	uint16_t   length;
+	lstring_t* string;
 
-	file_pos = ftell(file);
-	if (fread(&length, 2, 1, file) != 1) goto on_error;
-	return read_lstring_raw(file, length, trim_null);
+	file_pos = tell_memfile(file);
+	if (!read_memfile(file, &length, 2)) goto on_error;
+	if ((string = read_lstring_raw(file, length, trim_null)) == NULL)
+		goto on_error;
+	return string;
 
 on_error:
-	fseek(file, file_pos, SEEK_CUR);
+	seek_memfile(file, file_pos, SEEK_SET);
 	return NULL;
 }
 
 lstring_t*
-read_lstring_raw(FILE* file, size_t length, bool trim_null)
+read_lstring_raw(memfile_t* file, size_t length, bool trim_null)
 {
 	long       file_pos;
 	lstring_t* string = NULL;
 
-	file_pos = ftell(file);
+	file_pos = tell_memfile(file);
 	if ((string = calloc(1, sizeof(lstring_t))) == NULL)
 		goto on_error;
 	string->length = length;
 	if ((string->cstr = calloc(length + 1, sizeof(char))) == NULL) goto on_error;
-	if (fread((char*)string->cstr, 1, length, file) != length) goto on_error;
+	if (!read_memfile(file, (char*)string->cstr, length)) goto on_error;
 	if (trim_null) string->length = strchr(string->cstr, '\0') - string->cstr;
 	return string;
 
 on_error:
-	fseek(file, file_pos, SEEK_CUR);
+	seek_memfile(file, file_pos, SEEK_SET);
 	if (string != NULL) {
 		free((char*)string->cstr);
 		free(string);
@@ -613,6 +613,7 @@ initialize_engine(void)
 
 	// initialize JavaScript API
 	g_duktape = duk_create_heap(NULL, NULL, NULL, NULL, &on_duk_fatal);
+	initialize_scripts();
 	init_api(g_duktape);
 	init_bytearray_api();
 	init_color_api();
@@ -636,6 +637,8 @@ shutdown_engine(void)
 {
 	shutdown_map_engine();
 	duk_destroy_heap(g_duktape);
+	shutdown_scripts();
+	shutdown_spritesets();
 	dyad_shutdown();
 	shutdown_input();
 	al_uninstall_audio();
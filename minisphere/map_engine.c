@@ -4,12 +4,15 @@
 #include "image.h"
 #include "input.h"
 #include "obsmap.h"
+#include "pathfind.h"
 #include "persons.h"
 #include "surface.h"
 #include "tileset.h"
 
 #include "map_engine.h"
 
+#define MAP_CHUNK_SIZE 256
+
 enum map_script_type
 {
 	MAP_SCRIPT_ON_ENTER,
@@ -29,17 +32,31 @@ static struct map_zone*    get_zone_at         (int x, int y, int layer, int whi
 static bool                change_map          (const char* filename, bool preserve_persons);
 static int                 find_layer          (const char* name);
 static void                map_screen_to_layer (int layer, int camera_x, int camera_y, int* inout_x, int* inout_y);
+static bool                enable_layer_cache  (int layer, bool is_enabled);
+static void                free_layer_cache    (map_t* map, int layer);
+static void                invalidate_cell     (int layer, int x, int y);
+static void                invalidate_chunks   (void);
+static bool                render_chunk        (int layer, int chunk_x, int chunk_y);
+static void                draw_cached_layer   (int layer, int off_x, int off_y);
+static bool                build_obs_raster    (int layer);
+static void                bake_obs_cell       (int layer, int x, int y);
+static bool                test_raster_column  (int layer, int x, int y1, int y2, int* out_y);
+static bool                test_raster_span    (int layer, int y, int x1, int x2, int* out_x);
 static void                process_map_input   (void);
 static void                render_map          (void);
 static void                update_map_engine   (bool is_main_loop);
+static void                pop_delay_script    (void);
+static bool                push_delay_script   (int script_id, int frames);
 
 static duk_ret_t js_MapEngine               (duk_context* ctx);
 static duk_ret_t js_AreZonesAt              (duk_context* ctx);
 static duk_ret_t js_IsCameraAttached        (duk_context* ctx);
 static duk_ret_t js_IsInputAttached         (duk_context* ctx);
+static duk_ret_t js_IsLayerCached           (duk_context* ctx);
 static duk_ret_t js_IsLayerReflective       (duk_context* ctx);
 static duk_ret_t js_IsLayerVisible          (duk_context* ctx);
 static duk_ret_t js_IsMapEngineRunning      (duk_context* ctx);
+static duk_ret_t js_IsObstructionRasterEnabled (duk_context* ctx);
 static duk_ret_t js_IsTriggerAt             (duk_context* ctx);
 static duk_ret_t js_GetCameraPerson         (duk_context* ctx);
 static duk_ret_t js_GetCameraX              (duk_context* ctx);
@@ -75,12 +92,14 @@ static duk_ret_t js_SetCameraX              (duk_context* ctx);
 static duk_ret_t js_SetCameraY              (duk_context* ctx);
 static duk_ret_t js_SetColorMask            (duk_context* ctx);
 static duk_ret_t js_SetDefaultMapScript     (duk_context* ctx);
+static duk_ret_t js_SetLayerCached          (duk_context* ctx);
 static duk_ret_t js_SetLayerMask            (duk_context* ctx);
 static duk_ret_t js_SetLayerReflective      (duk_context* ctx);
 static duk_ret_t js_SetLayerRenderer        (duk_context* ctx);
 static duk_ret_t js_SetLayerVisible         (duk_context* ctx);
 static duk_ret_t js_SetMapEngineFrameRate   (duk_context* ctx);
 static duk_ret_t js_SetNextAnimatedTile     (duk_context* ctx);
+static duk_ret_t js_SetObstructionRaster    (duk_context* ctx);
 static duk_ret_t js_SetRenderScript         (duk_context* ctx);
 static duk_ret_t js_SetTalkActivationButton (duk_context* ctx);
 static duk_ret_t js_SetTalkActivationKey    (duk_context* ctx);
@@ -130,19 +149,22 @@ static bool                s_is_talk_allowed   = true;
 static bool                s_is_map_running    = false;
 static map_t*              s_map = NULL;
 static char*               s_map_filename      = NULL;
+static bool                s_use_obs_raster    = false;
 static struct map_trigger* s_on_trigger        = NULL;
 static int                 s_render_script     = 0;
 static int                 s_talk_button       = 0;
 static int                 s_talk_key          = ALLEGRO_KEY_SPACE;
 static int                 s_update_script     = 0;
+static unsigned int        s_delay_clock       = 0;
+static unsigned int        s_delay_serial      = 0;
 static int                 s_num_delay_scripts = 0;
 static int                 s_max_delay_scripts = 0;
 static struct delay_script *s_delay_scripts    = NULL;
 
 struct delay_script
 {
-	int script_id;
-	int frames_left;
+	int      script_id;
+	uint64_t order_key;
 };
 
 struct map
@@ -177,6 +199,22 @@ struct map_layer
 	obsmap_t*        obsmap;
 	color_t          color_mask;
 	int              render_script;
+	int              chunk_w, chunk_h;
+	int              num_chunks_x;
+	int              num_chunks_y;
+	struct map_chunk *chunks;
+	int              raster_pitch;
+	int              raster_plane;
+	uint32_t*        obs_raster;
+};
+
+struct map_chunk
+{
+	image_t* image;
+	bool     is_dirty;
+	int      num_anim_cells;
+	int      max_anim_cells;
+	int*     anim_cells;
 };
 
 struct map_person
@@ -271,6 +309,7 @@ void
 initialize_map_engine(void)
 {
 	initialize_persons_manager();
+	initialize_pathfinder();
 	memset(s_def_scripts, 0, MAP_SCRIPT_MAX * sizeof(int));
 	s_map = NULL; s_map_filename = NULL;
 	s_input_person = s_camera_person = NULL;
@@ -278,11 +317,13 @@ initialize_map_engine(void)
 	s_current_zone = -1;
 	s_render_script = 0;
 	s_update_script = 0;
+	s_delay_clock = s_delay_serial = 0;
 	s_num_delay_scripts = s_max_delay_scripts = 0;
 	s_delay_scripts = NULL;
 	s_talk_key = ALLEGRO_KEY_SPACE;
 	s_talk_button = 0;
 	s_is_map_running = false;
+	s_use_obs_raster = false;
 	s_color_mask = rgba(0, 0, 0, 0);
 	s_on_trigger = NULL;
 }
@@ -294,7 +335,11 @@ shutdown_map_engine(void)
 
 	for (i = 0; i < s_num_delay_scripts; ++i) free_script(s_delay_scripts[i].script_id);
 	free(s_delay_scripts);
+	for (i = 0; i < MAP_SCRIPT_MAX; ++i) free_script(s_def_scripts[i]);
+	free_script(s_render_script);
+	free_script(s_update_script);
 	free_map(s_map);
+	shutdown_pathfinder();
 	shutdown_persons_manager();
 }
 
@@ -363,6 +408,73 @@ normalize_map_entity_xy(double* inout_x, double* inout_y, int layer)
 	if (inout_y) *inout_y = fmod(fmod(*inout_y, layer_h) + layer_h, layer_h);
 }
 
+bool
+test_map_tile_area(int layer, rect_t area)
+{
+	// like test_map_tile_obs(), but segments lying entirely inside the area count as
+	// well. the raster only records what rect edges can hit, so it isn't used here.
+	const obsmap_t* obsmap;
+	int             tile_w, tile_h;
+	int             x1, y1, x2, y2;
+
+	int i_x, i_y;
+
+	// segments may stick out of their tile, so look one tile further in each direction
+	get_tile_size(s_map->tileset, &tile_w, &tile_h);
+	x1 = floor((double)area.x1 / tile_w) - 1;
+	y1 = floor((double)area.y1 / tile_h) - 1;
+	x2 = floor((double)area.x2 / tile_w) + 1;
+	y2 = floor((double)area.y2 / tile_h) + 1;
+	for (i_y = y1; i_y <= y2; ++i_y) for (i_x = x1; i_x <= x2; ++i_x) {
+		obsmap = get_tile_obsmap(s_map->tileset, get_map_tile(i_x, i_y, layer));
+		if (obsmap != NULL && test_obsmap_area(obsmap, translate_rect(area, -(i_x * tile_w), -(i_y * tile_h))))
+			return true;
+	}
+	return false;
+}
+
+bool
+test_map_tile_obs(int layer, rect_t rect, int* out_tile_index)
+{
+	rect_t          area;
+	rect_t          base;
+	const obsmap_t* obsmap;
+	int             tile_w, tile_h;
+	int             x, y;
+
+	int i_x, i_y;
+	
+	get_tile_size(s_map->tileset, &tile_w, &tile_h);
+	if (s_map->layers[layer].obs_raster != NULL) {
+		// test the rect's edges against the precomputed raster, like test_obsmap_rect()
+		// does with the actual segments. a zero-length edge can't cross anything.
+		if (rect.x1 != rect.x2 && test_raster_span(layer, rect.y1, rect.x1, rect.x2, &x)) y = rect.y1;
+		else if (rect.x1 != rect.x2 && test_raster_span(layer, rect.y2, rect.x1, rect.x2, &x)) y = rect.y2;
+		else if (rect.y1 != rect.y2 && test_raster_column(layer, rect.x1, rect.y1, rect.y2, &y)) x = rect.x1;
+		else if (rect.y1 != rect.y2 && test_raster_column(layer, rect.x2, rect.y1, rect.y2, &y)) x = rect.x2;
+		else
+			return false;
+		if (out_tile_index)
+			*out_tile_index = get_map_tile(floor((double)x / tile_w), floor((double)y / tile_h), layer);
+		return true;
+	}
+	
+	// no raster, check the segments of the tiles in the immediate vicinity
+	area.x1 = rect.x1 / tile_w;
+	area.y1 = rect.y1 / tile_h;
+	area.x2 = area.x1 + (rect.x2 - rect.x1) / tile_w + 2;
+	area.y2 = area.y1 + (rect.y2 - rect.y1) / tile_h + 2;
+	for (i_x = area.x1; i_x < area.x2; ++i_x) for (i_y = area.y1; i_y < area.y2; ++i_y) {
+		base = translate_rect(rect, -(i_x * tile_w), -(i_y * tile_h));
+		obsmap = get_tile_obsmap(s_map->tileset, get_map_tile(i_x, i_y, layer));
+		if (obsmap != NULL && test_obsmap_rect(obsmap, base)) {
+			if (out_tile_index) *out_tile_index = get_map_tile(i_x, i_y, layer);
+			return true;
+		}
+	}
+	return false;
+}
+
 static map_t*
 load_map(const char* path)
 {
@@ -378,7 +490,7 @@ load_map(const char* path)
 
 	uint16_t                 count;
 	struct rmp_entity_header entity_hdr;
-	FILE*                    file;
+	memfile_t*               file;
 	bool                     has_failed;
 	struct map_layer*        layer;
 	struct rmp_layer_header  layer_hdr;
@@ -399,9 +511,9 @@ load_map(const char* path)
 
 	memset(&rmp, 0, sizeof(struct rmp_header));
 	
-	if (!(file = fopen(path, "rb"))) goto on_error;
+	if (!(file = open_memfile(path))) goto on_error;
 	if (!(map = calloc(1, sizeof(map_t)))) goto on_error;
-	if (fread(&rmp, sizeof(struct rmp_header), 1, file) != 1)
+	if (!read_memfile(file, &rmp, sizeof(struct rmp_header)))
 		goto on_error;
 	if (memcmp(rmp.signature, ".rmp", 4) != 0) goto on_error;
 	if (rmp.num_strings != 3 && rmp.num_strings != 5 && rmp.num_strings < 9)
@@ -424,7 +536,7 @@ load_map(const char* path)
 
 		// load layers
 		for (i = 0; i < rmp.num_layers; ++i) {
-			if (fread(&layer_hdr, sizeof(struct rmp_layer_header), 1, file) != 1)
+			if (!read_memfile(file, &layer_hdr, sizeof(struct rmp_layer_header)))
 				goto on_error;
 			layer = &map->layers[i];
 			layer->is_parallax = (layer_hdr.flags & 2) != 0x0;
@@ -447,13 +559,14 @@ load_map(const char* path)
 			layer->name = read_lstring(file, true);
 			num_tiles = layer_hdr.width * layer_hdr.height;
 			if ((tile_data = malloc(num_tiles * 2)) == NULL) goto on_error;
-			if (fread(tile_data, 2, num_tiles, file) != num_tiles) goto on_error;
+			if (!read_memfile(file, tile_data, num_tiles * 2)) goto on_error;
 			for (j = 0; j < num_tiles; ++j)
 				layer->tilemap[j].tile_index = tile_data[j];
 			for (j = 0; j < layer_hdr.num_segments; ++j) {
-				if (!fread_rect_32(file, &segment)) goto on_error;
+				if (!read_rect_32(file, &segment)) goto on_error;
 				add_obsmap_line(layer->obsmap, segment);
 			}
+			build_obsmap_index(layer->obsmap);
 			free(tile_data); tile_data = NULL;
 		}
 
@@ -464,7 +577,7 @@ load_map(const char* path)
 		map->num_persons = 0;
 		map->num_triggers = 0;
 		for (i = 0; i < rmp.num_entities; ++i) {
-			if (fread(&entity_hdr, sizeof(struct rmp_entity_header), 1, file) != 1)
+			if (!read_memfile(file, &entity_hdr, sizeof(struct rmp_entity_header)))
 				goto on_error;
 			switch (entity_hdr.type) {
 			case 1:  // person
@@ -474,7 +587,7 @@ load_map(const char* path)
 				if ((person->name = read_lstring(file, true)) == NULL) goto on_error;
 				if ((person->spriteset = read_lstring(file, true)) == NULL) goto on_error;
 				person->x = entity_hdr.x; person->y = entity_hdr.y; person->z = entity_hdr.z;
-				if (fread(&count, 2, 1, file) != 1 || count < 5) goto on_error;
+				if (!read_memfile(file, &count, 2) || count < 5) goto on_error;
 				person->create_script = read_lstring(file, false);
 				person->destroy_script = read_lstring(file, false);
 				person->touch_script = read_lstring(file, false);
@@ -483,7 +596,7 @@ load_map(const char* path)
 				for (j = 5; j < count; ++j) {
 					free_lstring(read_lstring(file, true));
 				}
-				fseek(file, 16, SEEK_CUR);
+				seek_memfile(file, 16, SEEK_CUR);
 				break;
 			case 2:  // trigger
 				if ((script = read_lstring(file, false)) == NULL) goto on_error;
@@ -503,7 +616,7 @@ load_map(const char* path)
 
 		// load zones
 		for (i = 0; i < rmp.num_zones; ++i) {
-			if (fread(&zone_hdr, sizeof(struct rmp_zone_header), 1, file) != 1)
+			if (!read_memfile(file, &zone_hdr, sizeof(struct rmp_zone_header)))
 				goto on_error;
 			if ((script = read_lstring(file, false)) == NULL) goto on_error;
 			map->zones[i].layer = zone_hdr.layer;
@@ -553,11 +666,11 @@ load_map(const char* path)
 	default:
 		goto on_error;
 	}
-	fclose(file);
+	close_memfile(file);
 	return map;
 
 on_error:
-	if (file != NULL) fclose(file);
+	close_memfile(file);
 	free(tile_data);
 	if (strings != NULL) {
 		for (i = 0; i < rmp.num_strings; ++i) free_lstring(strings[i]);
@@ -600,6 +713,8 @@ free_map(map_t* map)
 		for (i = 0; i < MAP_SCRIPT_MAX; ++i)
 			free_script(map->scripts[i]);
 		for (i = 0; i < map->num_layers; ++i) {
+			free_layer_cache(map, i);
+			free(map->layers[i].obs_raster);
 			free_lstring(map->layers[i].name);
 			free(map->layers[i].tilemap);
 			free_obsmap(map->layers[i].obsmap);
@@ -718,6 +833,10 @@ change_map(const char* filename, bool preserve_persons)
 	}
 	free_map(s_map); free(s_map_filename);
 	s_map = map; s_map_filename = strdup(filename);
+	if (s_use_obs_raster) {
+		for (i = 0; i < s_map->num_layers; ++i)
+			build_obs_raster(i);
+	}
 	reset_persons(preserve_persons);
 
 	// populate persons
@@ -794,6 +913,370 @@ map_screen_to_layer(int layer, int camera_x, int camera_y, int* inout_x, int* in
 	if (inout_y) *inout_y += y_offset;
 }
 
+static bool
+enable_layer_cache(int layer, bool is_enabled)
+{
+	int               num_chunks;
+	struct map_layer* p_layer;
+	int               tile_w, tile_h;
+
+	int i;
+
+	p_layer = &s_map->layers[layer];
+	if (!is_enabled) {
+		free_layer_cache(s_map, layer);
+		return true;
+	}
+	if (p_layer->chunks != NULL)
+		return true;
+	get_tile_size(s_map->tileset, &tile_w, &tile_h);
+	p_layer->chunk_w = fmax(MAP_CHUNK_SIZE / tile_w, 1);
+	p_layer->chunk_h = fmax(MAP_CHUNK_SIZE / tile_h, 1);
+	p_layer->num_chunks_x = (p_layer->width + p_layer->chunk_w - 1) / p_layer->chunk_w;
+	p_layer->num_chunks_y = (p_layer->height + p_layer->chunk_h - 1) / p_layer->chunk_h;
+	num_chunks = p_layer->num_chunks_x * p_layer->num_chunks_y;
+	if (!(p_layer->chunks = calloc(num_chunks, sizeof(struct map_chunk))))
+		return false;
+	for (i = 0; i < num_chunks; ++i)
+		p_layer->chunks[i].is_dirty = true;
+	return true;
+}
+
+static void
+free_layer_cache(map_t* map, int layer)
+{
+	struct map_chunk* chunks;
+	int               num_chunks;
+
+	int i;
+
+	if ((chunks = map->layers[layer].chunks) == NULL)
+		return;
+	num_chunks = map->layers[layer].num_chunks_x * map->layers[layer].num_chunks_y;
+	for (i = 0; i < num_chunks; ++i) {
+		free_image(chunks[i].image);
+		free(chunks[i].anim_cells);
+	}
+	free(chunks);
+	map->layers[layer].chunks = NULL;
+}
+
+static void
+invalidate_cell(int layer, int x, int y)
+{
+	struct map_layer* p_layer;
+
+	p_layer = &s_map->layers[layer];
+	if (p_layer->chunks == NULL)
+		return;
+	if (x < 0 || x >= p_layer->width || y < 0 || y >= p_layer->height)
+		return;
+	p_layer->chunks[x / p_layer->chunk_w + y / p_layer->chunk_h * p_layer->num_chunks_x].is_dirty = true;
+}
+
+static void
+invalidate_chunks(void)
+{
+	struct map_layer* p_layer;
+
+	int i, z;
+
+	for (z = 0; z < s_map->num_layers; ++z) {
+		p_layer = &s_map->layers[z];
+		if (p_layer->chunks == NULL)
+			continue;
+		for (i = 0; i < p_layer->num_chunks_x * p_layer->num_chunks_y; ++i)
+			p_layer->chunks[i].is_dirty = true;
+	}
+}
+
+static bool
+render_chunk(int layer, int chunk_x, int chunk_y)
+{
+	struct map_chunk* chunk;
+	int*              new_list;
+	ALLEGRO_BITMAP*   old_target;
+	struct map_layer* p_layer;
+	int               tile_index;
+	int               tile_w, tile_h;
+	int               x1, y1, x2, y2;
+
+	int x, y;
+
+	p_layer = &s_map->layers[layer];
+	chunk = &p_layer->chunks[chunk_x + chunk_y * p_layer->num_chunks_x];
+	get_tile_size(s_map->tileset, &tile_w, &tile_h);
+	x1 = chunk_x * p_layer->chunk_w;
+	y1 = chunk_y * p_layer->chunk_h;
+	x2 = fmin(x1 + p_layer->chunk_w, p_layer->width);
+	y2 = fmin(y1 + p_layer->chunk_h, p_layer->height);
+	if (chunk->image == NULL && !(chunk->image = create_image((x2 - x1) * tile_w, (y2 - y1) * tile_h)))
+		return false;
+	fill_image(chunk->image, rgba(0, 0, 0, 0));
+	old_target = al_get_target_bitmap();
+	al_set_target_bitmap(get_image_bitmap(chunk->image));
+	
+	// cells never overlap, so tiles can be copied into the chunk as-is. this keeps
+	// translucent tiles from being blended twice when the chunk is drawn.
+	al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
+	chunk->num_anim_cells = 0;
+	begin_tile_batch(s_map->tileset, rgba(255, 255, 255, 255));
+	for (y = y1; y < y2; ++y) for (x = x1; x < x2; ++x) {
+		tile_index = p_layer->tilemap[x + y * p_layer->width].tile_index;
+		if (is_tile_animated(s_map->tileset, tile_index)) {
+			// animated tiles can't be cached, so keep track of them to be drawn per frame
+			if (++chunk->num_anim_cells > chunk->max_anim_cells) {
+				chunk->max_anim_cells = chunk->num_anim_cells * 2;
+				if (!(new_list = realloc(chunk->anim_cells, chunk->max_anim_cells * sizeof(int))))
+					goto on_error;
+				chunk->anim_cells = new_list;
+			}
+			chunk->anim_cells[chunk->num_anim_cells - 1] = x + y * p_layer->width;
+		}
+		else
+			batch_tile(s_map->tileset, (x - x1) * tile_w, (y - y1) * tile_h, tile_index);
+	}
+	end_tile_batch(s_map->tileset);
+	al_set_blender(ALLEGRO_ADD, ALLEGRO_ALPHA, ALLEGRO_INVERSE_ALPHA);
+	al_set_target_bitmap(old_target);
+	chunk->is_dirty = false;
+	return true;
+
+on_error:
+	end_tile_batch(s_map->tileset);
+	al_set_blender(ALLEGRO_ADD, ALLEGRO_ALPHA, ALLEGRO_INVERSE_ALPHA);
+	al_set_target_bitmap(old_target);
+	chunk->num_anim_cells = 0;
+	chunk->max_anim_cells = 0;
+	free(chunk->anim_cells);
+	chunk->anim_cells = NULL;
+	return false;
+}
+
+static void
+draw_cached_layer(int layer, int off_x, int off_y)
+{
+	int               cell_index;
+	struct map_chunk* chunk;
+	int               chunk_x, chunk_y;
+	int               chunk_px_w, chunk_px_h;
+	int               first_x, first_y, last_x, last_y;
+	bool              is_repeating;
+	int               layer_w, layer_h;
+	ALLEGRO_COLOR     mask;
+	int               num_copies_x, num_copies_y;
+	int               origin_x, origin_y;
+	struct map_layer* p_layer;
+	int               tile_w, tile_h;
+
+	int cx, cy, i, x, y;
+
+	p_layer = &s_map->layers[layer];
+	get_tile_size(s_map->tileset, &tile_w, &tile_h);
+	is_repeating = s_map->is_repeating || p_layer->is_parallax;
+	layer_w = p_layer->width * tile_w;
+	layer_h = p_layer->height * tile_h;
+	chunk_px_w = p_layer->chunk_w * tile_w;
+	chunk_px_h = p_layer->chunk_h * tile_h;
+	mask = nativecolor(p_layer->color_mask);
+	
+	// repeating layers are drawn once per visible copy, the same as persons
+	num_copies_x = is_repeating ? g_res_x / layer_w + 2 : 1;
+	num_copies_y = is_repeating ? g_res_y / layer_h + 2 : 1;
+	for (y = 0; y < num_copies_y; ++y) for (x = 0; x < num_copies_x; ++x) {
+		origin_x = x * layer_w - off_x;
+		origin_y = y * layer_h - off_y;
+		if (origin_x >= g_res_x || origin_y >= g_res_y || origin_x + layer_w <= 0 || origin_y + layer_h <= 0)
+			continue;
+		first_x = origin_x < 0 ? -origin_x / chunk_px_w : 0;
+		first_y = origin_y < 0 ? -origin_y / chunk_px_h : 0;
+		last_x = fmin((g_res_x - 1 - origin_x) / chunk_px_w, p_layer->num_chunks_x - 1);
+		last_y = fmin((g_res_y - 1 - origin_y) / chunk_px_h, p_layer->num_chunks_y - 1);
+		for (chunk_y = first_y; chunk_y <= last_y; ++chunk_y) for (chunk_x = first_x; chunk_x <= last_x; ++chunk_x) {
+			chunk = &p_layer->chunks[chunk_x + chunk_y * p_layer->num_chunks_x];
+			if (chunk->is_dirty) {
+				al_hold_bitmap_drawing(false);
+				render_chunk(layer, chunk_x, chunk_y);
+				al_hold_bitmap_drawing(true);
+			}
+			if (!chunk->is_dirty) {
+				al_draw_tinted_bitmap(get_image_bitmap(chunk->image), mask,
+					origin_x + chunk_x * chunk_px_w, origin_y + chunk_y * chunk_px_h, 0x0);
+				for (i = 0; i < chunk->num_anim_cells; ++i) {
+					cell_index = chunk->anim_cells[i];
+					draw_tile(s_map->tileset, p_layer->color_mask,
+						origin_x + cell_index % p_layer->width * tile_w,
+						origin_y + cell_index / p_layer->width * tile_h,
+						p_layer->tilemap[cell_index].tile_index);
+				}
+			}
+			else {
+				// chunk couldn't be rendered, fall back on drawing it tile by tile
+				for (cy = chunk_y * p_layer->chunk_h; cy < fmin((chunk_y + 1) * p_layer->chunk_h, p_layer->height); ++cy)
+				for (cx = chunk_x * p_layer->chunk_w; cx < fmin((chunk_x + 1) * p_layer->chunk_w, p_layer->width); ++cx) {
+					draw_tile(s_map->tileset, p_layer->color_mask, origin_x + cx * tile_w, origin_y + cy * tile_h,
+						p_layer->tilemap[cx + cy * p_layer->width].tile_index);
+				}
+			}
+		}
+	}
+}
+
+static bool
+build_obs_raster(int layer)
+{
+	struct map_layer* p_layer;
+	int               tile_w, tile_h;
+	
+	int x, y;
+
+	p_layer = &s_map->layers[layer];
+	get_tile_size(s_map->tileset, &tile_w, &tile_h);
+	free(p_layer->obs_raster);
+	p_layer->raster_pitch = (p_layer->width * tile_w + 31) / 32;
+	p_layer->raster_plane = p_layer->raster_pitch * p_layer->height * tile_h;
+	if (!(p_layer->obs_raster = calloc(p_layer->raster_plane * 2, sizeof(uint32_t))))
+		return false;
+	for (y = 0; y < p_layer->height; ++y) for (x = 0; x < p_layer->width; ++x)
+		bake_obs_cell(layer, x, y);
+	return true;
+}
+
+static void
+bake_obs_cell(int layer, int x, int y)
+{
+	// the raster has two planes: rows of the first are tested by test_raster_span()
+	// and columns of the second by test_raster_column(). do_lines_intersect() never
+	// reports parallel lines as crossing, so horizontal segments are left out of the
+	// first plane, vertical ones out of the second, and single points out of both.
+	rect_t            clipped;
+	int               delta_x, delta_y;
+	int               err, err2;
+	bool              in_columns;
+	bool              in_spans;
+	rect_t            line;
+	const obsmap_t*   obsmap;
+	int               pitch;
+	struct map_layer* p_layer;
+	uint32_t*         raster;
+	int               step_x, step_y;
+	int               tile_index;
+	int               tile_w, tile_h;
+	int               x1, y1, x2, y2;
+
+	int i, p_x, p_y;
+
+	p_layer = &s_map->layers[layer];
+	if ((raster = p_layer->obs_raster) == NULL)
+		return;
+	if (x < 0 || x >= p_layer->width || y < 0 || y >= p_layer->height)
+		return;
+	pitch = p_layer->raster_pitch;
+	get_tile_size(s_map->tileset, &tile_w, &tile_h);
+	for (p_y = y * tile_h; p_y < (y + 1) * tile_h; ++p_y) for (p_x = x * tile_w; p_x < (x + 1) * tile_w; ++p_x) {
+		raster[p_x / 32 + p_y * pitch] &= ~(1U << (p_x % 32));
+		raster[p_layer->raster_plane + p_x / 32 + p_y * pitch] &= ~(1U << (p_x % 32));
+	}
+	tile_index = p_layer->tilemap[x + y * p_layer->width].tile_index;
+	if (tile_index < 0 || tile_index >= get_tile_count(s_map->tileset))
+		return;
+	if (!(obsmap = get_tile_obsmap(s_map->tileset, tile_index)))
+		return;
+	for (i = 0; i < get_obsmap_line_count(obsmap); ++i) {
+		// plot the segment with Bresenham's algorithm. it's clipped to the tile so that
+		// a cell can be rebaked without touching its neighbors.
+		line = get_obsmap_line(obsmap, i);
+		in_spans = line.y1 != line.y2;
+		in_columns = line.x1 != line.x2;
+		if (!in_spans && !in_columns)
+			continue;
+		clipped = line;
+		if (!clip_line(&clipped, new_rect(0, 0, tile_w, tile_h)))
+			continue;
+		x1 = clipped.x1 + x * tile_w; y1 = clipped.y1 + y * tile_h;
+		x2 = clipped.x2 + x * tile_w; y2 = clipped.y2 + y * tile_h;
+		delta_x = abs(x2 - x1); step_x = x1 < x2 ? 1 : -1;
+		delta_y = -abs(y2 - y1); step_y = y1 < y2 ? 1 : -1;
+		err = delta_x + delta_y;
+		while (true) {
+			if (in_spans)
+				raster[x1 / 32 + y1 * pitch] |= 1U << (x1 % 32);
+			if (in_columns)
+				raster[p_layer->raster_plane + x1 / 32 + y1 * pitch] |= 1U << (x1 % 32);
+			if (x1 == x2 && y1 == y2)
+				break;
+			err2 = err * 2;
+			if (err2 >= delta_y) { err += delta_y; x1 += step_x; }
+			if (err2 <= delta_x) { err += delta_x; y1 += step_y; }
+		}
+	}
+}
+
+static bool
+test_raster_column(int layer, int x, int y1, int y2, int* out_y)
+{
+	int               pitch;
+	struct map_layer* p_layer;
+	uint32_t*         raster;
+	int               raster_w, raster_h;
+	int               tile_w, tile_h;
+
+	int y;
+
+	p_layer = &s_map->layers[layer];
+	get_tile_size(s_map->tileset, &tile_w, &tile_h);
+	raster = p_layer->obs_raster + p_layer->raster_plane;
+	pitch = p_layer->raster_pitch;
+	raster_w = p_layer->width * tile_w;
+	raster_h = p_layer->height * tile_h;
+	x = (x % raster_w + raster_w) % raster_w;
+	for (y = y1; y <= y2; ++y) {
+		*out_y = (y % raster_h + raster_h) % raster_h;
+		if (raster[x / 32 + *out_y * pitch] & (1U << (x % 32)))
+			return true;
+	}
+	return false;
+}
+
+static bool
+test_raster_span(int layer, int y, int x1, int x2, int* out_x)
+{
+	int               first_bit, last_bit;
+	uint32_t          mask;
+	struct map_layer* p_layer;
+	uint32_t*         row;
+	int               run_length;
+	int               raster_w, raster_h;
+	int               tile_w, tile_h;
+	uint32_t          word;
+
+	int i, x;
+
+	p_layer = &s_map->layers[layer];
+	get_tile_size(s_map->tileset, &tile_w, &tile_h);
+	raster_w = p_layer->width * tile_w;
+	raster_h = p_layer->height * tile_h;
+	y = (y % raster_h + raster_h) % raster_h;
+	row = &p_layer->obs_raster[y * p_layer->raster_pitch];
+	while (x1 <= x2) {
+		// split the span where it wraps around the layer, then test each piece a
+		// word at a time
+		x = (x1 % raster_w + raster_w) % raster_w;
+		run_length = fmin(x2 - x1 + 1, raster_w - x);
+		x1 += run_length;
+		for (i = x / 32; i <= (x + run_length - 1) / 32; ++i) {
+			first_bit = i == x / 32 ? x % 32 : 0;
+			last_bit = i == (x + run_length - 1) / 32 ? (x + run_length - 1) % 32 : 31;
+			mask = (0xFFFFFFFFU >> (31 - last_bit)) & (0xFFFFFFFFU << first_bit);
+			if ((word = row[i] & mask) != 0) {
+				for (*out_x = i * 32 + first_bit; !(word & (1U << (*out_x % 32))); ++*out_x);
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
 static void
 process_map_input(void)
 {
@@ -895,15 +1378,25 @@ render_map(void)
 				render_persons(z, true, off_x, off_y);
 			}
 		}
-		first_cell_x = off_x / tile_w;
-		first_cell_y = off_y / tile_h;
-		for (y = 0; y < g_res_y / tile_h + 2; ++y) for (x = 0; x < g_res_x / tile_w + 2; ++x) {
-			cell_x = is_repeating ? (x + first_cell_x) % layer->width : x + first_cell_x;
-			cell_y = is_repeating ? (y + first_cell_y) % layer->height : y + first_cell_y;
-			if (cell_x < 0 || cell_x >= layer->width || cell_y < 0 || cell_y >= layer->height)
-				continue;
-			tile_index = layer->tilemap[cell_x + cell_y * layer->width].tile_index;
-			draw_tile(s_map->tileset, layer->color_mask, x * tile_w - off_x % tile_w, y * tile_h - off_y % tile_h, tile_index);
+		if (layer->chunks != NULL)
+			draw_cached_layer(z, off_x, off_y);
+		else {
+			// the whole layer goes to the GPU in a single draw call. primitives can't
+			// be drawn while bitmap drawing is held, so release it for the duration.
+			al_hold_bitmap_drawing(false);
+			begin_tile_batch(s_map->tileset, layer->color_mask);
+			first_cell_x = off_x / tile_w;
+			first_cell_y = off_y / tile_h;
+			for (y = 0; y < g_res_y / tile_h + 2; ++y) for (x = 0; x < g_res_x / tile_w + 2; ++x) {
+				cell_x = is_repeating ? (x + first_cell_x) % layer->width : x + first_cell_x;
+				cell_y = is_repeating ? (y + first_cell_y) % layer->height : y + first_cell_y;
+				if (cell_x < 0 || cell_x >= layer->width || cell_y < 0 || cell_y >= layer->height)
+					continue;
+				tile_index = layer->tilemap[cell_x + cell_y * layer->width].tile_index;
+				batch_tile(s_map->tileset, x * tile_w - off_x % tile_w, y * tile_h - off_y % tile_h, tile_index);
+			}
+			end_tile_batch(s_map->tileset);
+			al_hold_bitmap_drawing(true);
 		}
 		if (is_repeating) {
 			// for small repeating maps, persons need to be repeated as well
@@ -916,7 +1409,7 @@ render_map(void)
 		al_hold_bitmap_drawing(false);
 		run_script(layer->render_script, false);
 	}
-	overlay_color = al_map_rgba(s_color_mask.r, s_color_mask.g, s_color_mask.b, s_color_mask.alpha);
+	overlay_color = nativecolor(s_color_mask);
 	al_draw_filled_rectangle(0, 0, g_res_x, g_res_y, overlay_color);
 	run_script(s_render_script, false);
 }
@@ -929,13 +1422,14 @@ update_map_engine(bool is_main_loop)
 	int                 last_zone;
 	int                 layer;
 	int                 map_w, map_h;
+	int                 script_id;
 	int                 script_type;
 	int                 tile_w, tile_h;
 	struct map_trigger* trigger;
 	double              x, y;
 	struct map_zone*    zone;
 
-	int i, j;
+	int i;
 	
 	++s_frames;
 	get_tile_size(s_map->tileset, &tile_w, &tile_h);
@@ -1001,17 +1495,70 @@ update_map_engine(bool is_main_loop)
 	
 	run_script(s_update_script, false);
 	
-	// run delay scripts, if applicable
-	for (i = 0; i < s_num_delay_scripts; ++i) {
-		if (s_delay_scripts[i].frames_left-- <= 0) {
-			run_script(s_delay_scripts[i].script_id, false);
-			free_script(s_delay_scripts[i].script_id);
-			for (j = i; j < s_num_delay_scripts - 1; ++j) s_delay_scripts[j] = s_delay_scripts[j + 1];
-			--s_num_delay_scripts; --i;
-		}
+	// run delay scripts, if applicable. the queue is a min-heap ordered by firing
+	// frame, so nothing past the first pending script has to be looked at.
+	++s_delay_clock;
+	while (s_num_delay_scripts > 0 && s_delay_scripts[0].order_key >> 32 <= s_delay_clock) {
+		script_id = s_delay_scripts[0].script_id;
+		pop_delay_script();
+		run_script(script_id, false);
+		free_script(script_id);
 	}
 }
 
+static void
+pop_delay_script(void)
+{
+	int                 child;
+	struct delay_script last;
+	int                 parent;
+
+	last = s_delay_scripts[--s_num_delay_scripts];
+	parent = 0;
+	while ((child = parent * 2 + 1) < s_num_delay_scripts) {
+		if (child + 1 < s_num_delay_scripts && s_delay_scripts[child + 1].order_key < s_delay_scripts[child].order_key)
+			++child;
+		if (s_delay_scripts[child].order_key >= last.order_key)
+			break;
+		s_delay_scripts[parent] = s_delay_scripts[child];
+		parent = child;
+	}
+	s_delay_scripts[parent] = last;
+}
+
+static bool
+push_delay_script(int script_id, int frames)
+{
+	// the heap is ordered by firing frame in the upper 32 bits of the key and by
+	// a serial number in the lower 32, so scripts due on the same frame still fire
+	// in the order they were set. a script set for N frames fires on the (N + 1)th
+	// update from now, same as the old countdown.
+	
+	struct delay_script  delay;
+	int                  child;
+	struct delay_script* new_queue;
+	int                  parent;
+
+	if (s_num_delay_scripts + 1 > s_max_delay_scripts) {
+		if (!(new_queue = realloc(s_delay_scripts, (s_num_delay_scripts + 1) * 2 * sizeof(struct delay_script))))
+			return false;
+		s_max_delay_scripts = (s_num_delay_scripts + 1) * 2;
+		s_delay_scripts = new_queue;
+	}
+	delay.script_id = script_id;
+	delay.order_key = (uint64_t)(s_delay_clock + frames + 1) << 32 | s_delay_serial++;
+	child = s_num_delay_scripts++;
+	while (child > 0) {
+		parent = (child - 1) / 2;
+		if (delay.order_key >= s_delay_scripts[parent].order_key)
+			break;
+		s_delay_scripts[child] = s_delay_scripts[parent];
+		child = parent;
+	}
+	s_delay_scripts[child] = delay;
+	return true;
+}
+
 void
 init_map_engine_api(duk_context* ctx)
 {
@@ -1019,9 +1566,11 @@ init_map_engine_api(duk_context* ctx)
 	register_api_func(ctx, NULL, "AreZonesAt", js_AreZonesAt);
 	register_api_func(ctx, NULL, "IsCameraAttached", js_IsCameraAttached);
 	register_api_func(ctx, NULL, "IsInputAttached", js_IsInputAttached);
+	register_api_func(ctx, NULL, "IsLayerCached", js_IsLayerCached);
 	register_api_func(ctx, NULL, "IsLayerReflective", js_IsLayerReflective);
 	register_api_func(ctx, NULL, "IsLayerVisible", js_IsLayerVisible);
 	register_api_func(ctx, NULL, "IsMapEngineRunning", js_IsMapEngineRunning);
+	register_api_func(ctx, NULL, "IsObstructionRasterEnabled", js_IsObstructionRasterEnabled);
 	register_api_func(ctx, NULL, "IsTriggerAt", js_IsTriggerAt);
 	register_api_func(ctx, NULL, "GetCameraPerson", js_GetCameraPerson);
 	register_api_func(ctx, NULL, "GetCameraX", js_GetCameraX);
@@ -1057,12 +1606,14 @@ init_map_engine_api(duk_context* ctx)
 	register_api_func(ctx, NULL, "SetCameraY", js_SetCameraY);
 	register_api_func(ctx, NULL, "SetColorMask", js_SetColorMask);
 	register_api_func(ctx, NULL, "SetDefaultMapScript", js_SetDefaultMapScript);
+	register_api_func(ctx, NULL, "SetLayerCached", js_SetLayerCached);
 	register_api_func(ctx, NULL, "SetLayerMask", js_SetLayerMask);
 	register_api_func(ctx, NULL, "SetLayerReflective", js_SetLayerReflective);
 	register_api_func(ctx, NULL, "SetLayerRenderer", js_SetLayerRenderer);
 	register_api_func(ctx, NULL, "SetLayerVisible", js_SetLayerVisible);
 	register_api_func(ctx, NULL, "SetMapEngineFrameRate", js_SetMapEngineFrameRate);
 	register_api_func(ctx, NULL, "SetNextAnimatedTile", js_SetNextAnimatedTile);
+	register_api_func(ctx, NULL, "SetObstructionRaster", js_SetObstructionRaster);
 	register_api_func(ctx, NULL, "SetRenderScript", js_SetRenderScript);
 	register_api_func(ctx, NULL, "SetTalkActivationButton", js_SetTalkActivationButton);
 	register_api_func(ctx, NULL, "SetTalkActivationKey", js_SetTalkActivationKey);
@@ -1101,6 +1652,7 @@ init_map_engine_api(duk_context* ctx)
 
 	// initialize subcomponent APIs (persons, etc.)
 	init_persons_api();
+	init_pathfind_api();
 }
 
 int
@@ -1172,6 +1724,19 @@ js_IsInputAttached(duk_context* ctx)
 	return 1;
 }
 
+static duk_ret_t
+js_IsLayerCached(duk_context* ctx)
+{
+	int layer = duk_require_map_layer(ctx, 0);
+
+	if (!is_map_engine_running())
+		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "IsLayerCached(): Map engine must be running");
+	if (layer < 0 || layer >= s_map->num_layers)
+		duk_error_ni(ctx, -1, DUK_ERR_RANGE_ERROR, "IsLayerCached(): Invalid layer index (%i)", layer);
+	duk_push_boolean(ctx, s_map->layers[layer].chunks != NULL);
+	return 1;
+}
+
 static duk_ret_t
 js_IsLayerReflective(duk_context* ctx)
 {
@@ -1205,6 +1770,13 @@ js_IsMapEngineRunning(duk_context* ctx)
 	return 1;
 }
 
+static duk_ret_t
+js_IsObstructionRasterEnabled(duk_context* ctx)
+{
+	duk_push_boolean(ctx, s_use_obs_raster);
+	return 1;
+}
+
 static duk_ret_t
 js_IsTriggerAt(duk_context* ctx)
 {
@@ -1654,23 +2226,35 @@ js_SetDelayScript(duk_context* ctx)
 	int frames = duk_require_int(ctx, 0);
 	lstring_t* script = duk_require_lstring_t(ctx, 1);
 
-	struct delay_script* delay;
-	char                 script_name[100];
+	char script_name[100];
+	int  script_id;
 
 	if (!is_map_engine_running())
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "SetDelayScript(): Map engine is not running");
 	if (frames < 0)
 		duk_error_ni(ctx, -1, DUK_ERR_RANGE_ERROR, "SetDelayScript(): Delay frames cannot be negative");
-	if (++s_num_delay_scripts > s_max_delay_scripts) {
-		s_max_delay_scripts = s_num_delay_scripts * 2;
-		if (!(s_delay_scripts = realloc(s_delay_scripts, s_max_delay_scripts * sizeof(struct delay_script))))
-			duk_error_ni(ctx, -1, DUK_ERR_ERROR, "SetDelayScript(): Failed to enlarge delay script queue (internal error)");
-	}
-	delay = &s_delay_scripts[s_num_delay_scripts - 1];
 	sprintf(script_name, "[%i-frame delay script]", frames);
-	delay->script_id = compile_script(script, script_name);
-	delay->frames_left = frames;
+	script_id = compile_script(script, script_name);
 	free_lstring(script);
+	if (!push_delay_script(script_id, frames)) {
+		free_script(script_id);
+		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "SetDelayScript(): Failed to enlarge delay script queue (internal error)");
+	}
+	return 0;
+}
+
+static duk_ret_t
+js_SetLayerCached(duk_context* ctx)
+{
+	int layer = duk_require_map_layer(ctx, 0);
+	bool is_cached = duk_require_boolean(ctx, 1);
+
+	if (!is_map_engine_running())
+		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "SetLayerCached(): Map engine must be running");
+	if (layer < 0 || layer >= s_map->num_layers)
+		duk_error_ni(ctx, -1, DUK_ERR_RANGE_ERROR, "SetLayerCached(): Invalid layer index (%i)", layer);
+	if (!enable_layer_cache(layer, is_cached))
+		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "SetLayerCached(): Failed to create layer cache");
 	return 0;
 }
 
@@ -1755,6 +2339,28 @@ js_SetNextAnimatedTile(duk_context* ctx)
 	if (next_index < 0 || next_index >= get_tile_count(s_map->tileset))
 		duk_error_ni(ctx, -1, DUK_ERR_RANGE_ERROR, "SetNextAnimatedTile(): Invalid tile index for next tile (%i)", tile_index);
 	set_next_tile(s_map->tileset, tile_index, next_index);
+	invalidate_chunks();
+	return 0;
+}
+
+static duk_ret_t
+js_SetObstructionRaster(duk_context* ctx)
+{
+	bool is_enabled = duk_require_boolean(ctx, 0);
+
+	int i;
+
+	s_use_obs_raster = is_enabled;
+	if (s_map == NULL)
+		return 0;
+	for (i = 0; i < s_map->num_layers; ++i) {
+		if (!is_enabled) {
+			free(s_map->layers[i].obs_raster);
+			s_map->layers[i].obs_raster = NULL;
+		}
+		else if (s_map->layers[i].obs_raster == NULL && !build_obs_raster(i))
+			duk_error_ni(ctx, -1, DUK_ERR_ERROR, "SetObstructionRaster(): Failed to build obstruction raster for layer %i", i);
+	}
 	return 0;
 }
 
@@ -1806,6 +2412,8 @@ js_SetTile(duk_context* ctx)
 	struct map_tile* tilemap = s_map->layers[layer].tilemap;
 	tilemap[x + y * layer_w].tile_index = tile_index;
 	tilemap[x + y * layer_w].frames_left = get_tile_delay(s_map->tileset, tile_index);
+	invalidate_cell(layer, x, y);
+	bake_obs_cell(layer, x, y);
 	return 0;
 }
 
@@ -1822,6 +2430,7 @@ js_SetTileDelay(duk_context* ctx)
 	if (delay < 0)
 		duk_error_ni(ctx, -1, DUK_ERR_RANGE_ERROR, "SetTileDelay(): Delay cannot be negative (%i)", delay);
 	set_tile_delay(s_map->tileset, tile_index, delay);
+	invalidate_chunks();
 	return 0;
 }
 
@@ -1846,6 +2455,7 @@ js_SetTileImage(duk_context* ctx)
 	if (image_w != tile_w || image_h != tile_h)
 		duk_error_ni(ctx, -1, DUK_ERR_TYPE_ERROR, "SetTileImage(): Image dimensions (%ix%i) don't match tile dimensions (%ix%i)", image_w, image_h, tile_w, tile_h);
 	set_tile_image(s_map->tileset, tile_index, image);
+	invalidate_chunks();
 	return 0;
 }
 
@@ -1874,6 +2484,7 @@ js_SetTileSurface(duk_context* ctx)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "SetTileSurface(): Failed to create new tile image");
 	set_tile_image(s_map->tileset, tile_index, new_image);
 	free_image(new_image);
+	invalidate_chunks();
 	return 0;
 }
 
@@ -2106,7 +2717,11 @@ js_ReplaceTilesOnLayer(duk_context* ctx)
 	layer_h = s_map->layers[layer].height;
 	for (i_x = 0; i_x < layer_w; ++i_x) for (i_y = 0; i_y < layer_h; ++i_y) {
 		p_tile = &s_map->layers[layer].tilemap[i_x + i_y * layer_w];
-		if (p_tile->tile_index == old_index) p_tile->tile_index = new_index;
+		if (p_tile->tile_index == old_index) {
+			p_tile->tile_index = new_index;
+			invalidate_cell(layer, i_x, i_y);
+			bake_obs_cell(layer, i_x, i_y);
+		}
 	}
 	return 0;
 }
@@ -15,6 +15,8 @@ extern point3_t         get_map_origin          (void);
 extern int              get_map_tile            (int x, int y, int layer);
 extern const tileset_t* get_map_tileset         (void);
 extern void             normalize_map_entity_xy (double* inout_x, double* inout_y, int layer);
+extern bool             test_map_tile_area      (int layer, rect_t area);
+extern bool             test_map_tile_obs       (int layer, rect_t rect, int* out_tile_index);
 
 extern void             init_map_engine_api   (duk_context* ctx);
 extern int              duk_require_map_layer (duk_context* ctx, duk_idx_t index);
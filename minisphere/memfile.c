@@ -0,0 +1,95 @@
+#include "minisphere.h"
+
+#include "memfile.h"
+
+struct memfile
+{
+	uint8_t* buffer;
+	size_t   size;
+	size_t   position;
+};
+
+memfile_t*
+open_memfile(const char* path)
+{
+	// the whole file is read into memory up front so that loaders can parse it
+	// from a cursor instead of making hundreds of tiny fread() calls
+	
+	FILE*      file = NULL;
+	memfile_t* memfile = NULL;
+	long       size;
+
+	if (!(file = fopen(path, "rb"))) goto on_error;
+	if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0)
+		goto on_error;
+	fseek(file, 0, SEEK_SET);
+	if (!(memfile = calloc(1, sizeof(memfile_t)))) goto on_error;
+	if (!(memfile->buffer = malloc(size > 0 ? size : 1))) goto on_error;
+	if (fread(memfile->buffer, 1, size, file) != (size_t)size) goto on_error;
+	memfile->size = size;
+	fclose(file);
+	return memfile;
+
+on_error:
+	if (file != NULL) fclose(file);
+	if (memfile != NULL) {
+		free(memfile->buffer);
+		free(memfile);
+	}
+	return NULL;
+}
+
+void
+close_memfile(memfile_t* file)
+{
+	if (file == NULL)
+		return;
+	free(file->buffer);
+	free(file);
+}
+
+bool
+read_memfile(memfile_t* file, void* buffer, size_t size)
+{
+	const void* data;
+
+	if ((data = read_memfile_ptr(file, size)) == NULL)
+		return false;
+	memcpy(buffer, data, size);
+	return true;
+}
+
+const void*
+read_memfile_ptr(memfile_t* file, size_t size)
+{
+	// returns a pointer into the file buffer and advances past it. nothing is copied,
+	// so the data must be used (and not modified) before the file is closed.
+	
+	const void* data;
+	
+	if (size > file->size - file->position)
+		return NULL;
+	data = file->buffer + file->position;
+	file->position += size;
+	return data;
+}
+
+bool
+seek_memfile(memfile_t* file, long offset, int origin)
+{
+	long new_pos;
+
+	new_pos = origin == SEEK_CUR ? (long)file->position + offset
+		: origin == SEEK_END ? (long)file->size + offset
+		: offset;
+	if (new_pos < 0 || new_pos > (long)file->size)
+		return false;
+	file->position = new_pos;
+	return true;
+}
+
+long
+tell_memfile(memfile_t* file)
+{
+	return file->position;
+}
@@ -0,0 +1,13 @@
+#ifndef MINISPHERE__MEMFILE_H__INCLUDED
+#define MINISPHERE__MEMFILE_H__INCLUDED
+
+typedef struct memfile memfile_t;
+
+extern memfile_t*  open_memfile     (const char* path);
+extern void        close_memfile    (memfile_t* file);
+extern bool        read_memfile     (memfile_t* file, void* buffer, size_t size);
+extern const void* read_memfile_ptr (memfile_t* file, size_t size);
+extern bool        seek_memfile     (memfile_t* file, long offset, int origin);
+extern long        tell_memfile     (memfile_t* file);
+
+#endif // MINISPHERE__MEMFILE_H__INCLUDED
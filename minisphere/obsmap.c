@@ -2,11 +2,25 @@
 
 #include "obsmap.h"
 
+#define OBSMAP_CELL_SIZE  64
+#define OBSMAP_MAX_CELLS  65536
+#define OBSMAP_MIN_LINES  32
+
+static void free_obsmap_index (obsmap_t* obsmap);
+static bool test_area_line    (rect_t area, rect_t line);
+static bool test_line_linear  (const obsmap_t* obsmap, rect_t line);
+
 struct obsmap
 {
 	int    num_lines;
 	int    max_lines;
 	rect_t *lines;
+	bool   has_index;
+	rect_t bounds;
+	int    cell_size;
+	int    grid_w, grid_h;
+	int*   cell_offsets;
+	int*   cell_lines;
 };
 
 obsmap_t*
@@ -26,6 +40,7 @@ free_obsmap(obsmap_t* obsmap)
 {
 	if (obsmap == NULL)
 		return;
+	free_obsmap_index(obsmap);
 	free(obsmap->lines);
 	free(obsmap);
 }
@@ -45,17 +60,152 @@ add_obsmap_line(obsmap_t* obsmap, rect_t line)
 	}
 	obsmap->lines[obsmap->num_lines] = line;
 	++obsmap->num_lines;
+	free_obsmap_index(obsmap);
 	return true;
 }
 
 bool
-test_obsmap_line(const obsmap_t* obsmap, rect_t line)
+build_obsmap_index(obsmap_t* obsmap)
 {
-	int i;
+	rect_t  bounds;
+	int     cell_size;
+	int     grid_w, grid_h;
+	rect_t* line;
+	int     num_cells;
+	int*    fill_counts = NULL;
+	
+	int i, x, y;
 
+	free_obsmap_index(obsmap);
+	if (obsmap->num_lines < OBSMAP_MIN_LINES)
+		return true;  // not worth indexing, a linear search will do
+	
+	// find the extents of all segments
+	line = &obsmap->lines[0];
+	bounds = new_rect(line->x1, line->y1, line->x1, line->y1);
 	for (i = 0; i < obsmap->num_lines; ++i) {
-		if (do_lines_intersect(line, obsmap->lines[i]))
-			return true;
+		line = &obsmap->lines[i];
+		bounds.x1 = fmin(bounds.x1, fmin(line->x1, line->x2));
+		bounds.y1 = fmin(bounds.y1, fmin(line->y1, line->y2));
+		bounds.x2 = fmax(bounds.x2, fmax(line->x1, line->x2));
+		bounds.y2 = fmax(bounds.y2, fmax(line->y1, line->y2));
+	}
+	cell_size = OBSMAP_CELL_SIZE;
+	do {
+		grid_w = (bounds.x2 - bounds.x1) / cell_size + 1;
+		grid_h = (bounds.y2 - bounds.y1) / cell_size + 1;
+		num_cells = grid_w * grid_h;
+		if (num_cells > OBSMAP_MAX_CELLS) cell_size *= 2;
+	} while (num_cells > OBSMAP_MAX_CELLS);
+	
+	// bucket the segments by the grid cells their bounding boxes touch. cell_offsets[]
+	// holds the start of each cell's run in cell_lines[], with one extra entry at the end.
+	if (!(obsmap->cell_offsets = calloc(num_cells + 1, sizeof(int)))) goto on_error;
+	if (!(fill_counts = calloc(num_cells, sizeof(int)))) goto on_error;
+	for (i = 0; i < obsmap->num_lines; ++i) {
+		line = &obsmap->lines[i];
+		for (y = (fmin(line->y1, line->y2) - bounds.y1) / cell_size; y <= (fmax(line->y1, line->y2) - bounds.y1) / cell_size; ++y)
+		for (x = (fmin(line->x1, line->x2) - bounds.x1) / cell_size; x <= (fmax(line->x1, line->x2) - bounds.x1) / cell_size; ++x)
+			++obsmap->cell_offsets[x + y * grid_w + 1];
+	}
+	for (i = 0; i < num_cells; ++i)
+		obsmap->cell_offsets[i + 1] += obsmap->cell_offsets[i];
+	if (!(obsmap->cell_lines = malloc(obsmap->cell_offsets[num_cells] * sizeof(int)))) goto on_error;
+	for (i = 0; i < obsmap->num_lines; ++i) {
+		line = &obsmap->lines[i];
+		for (y = (fmin(line->y1, line->y2) - bounds.y1) / cell_size; y <= (fmax(line->y1, line->y2) - bounds.y1) / cell_size; ++y)
+		for (x = (fmin(line->x1, line->x2) - bounds.x1) / cell_size; x <= (fmax(line->x1, line->x2) - bounds.x1) / cell_size; ++x) {
+			obsmap->cell_lines[obsmap->cell_offsets[x + y * grid_w] + fill_counts[x + y * grid_w]] = i;
+			++fill_counts[x + y * grid_w];
+		}
+	}
+	free(fill_counts);
+	obsmap->bounds = bounds;
+	obsmap->cell_size = cell_size;
+	obsmap->grid_w = grid_w;
+	obsmap->grid_h = grid_h;
+	obsmap->has_index = true;
+	return true;
+
+on_error:
+	free(fill_counts);
+	free_obsmap_index(obsmap);
+	return false;
+}
+
+int
+get_obsmap_line_count(const obsmap_t* obsmap)
+{
+	return obsmap->num_lines;
+}
+
+rect_t
+get_obsmap_line(const obsmap_t* obsmap, int index)
+{
+	return obsmap->lines[index];
+}
+
+bool
+test_obsmap_area(const obsmap_t* obsmap, rect_t area)
+{
+	// unlike test_obsmap_rect(), this also catches segments lying entirely inside
+	// the area, as when a rect is swept across them
+	
+	int x1, y1, x2, y2;
+	
+	int i, x, y;
+
+	if (!obsmap->has_index) {
+		for (i = 0; i < obsmap->num_lines; ++i)
+			if (test_area_line(area, obsmap->lines[i])) return true;
+		return false;
+	}
+	x1 = area.x1 - obsmap->bounds.x1;
+	y1 = area.y1 - obsmap->bounds.y1;
+	x2 = area.x2 - obsmap->bounds.x1;
+	y2 = area.y2 - obsmap->bounds.y1;
+	if (x2 < 0 || y2 < 0 || x1 >= obsmap->grid_w * obsmap->cell_size || y1 >= obsmap->grid_h * obsmap->cell_size)
+		return false;
+	x1 = fmax(x1, 0) / obsmap->cell_size;
+	y1 = fmax(y1, 0) / obsmap->cell_size;
+	x2 = fmin(x2 / obsmap->cell_size, obsmap->grid_w - 1);
+	y2 = fmin(y2 / obsmap->cell_size, obsmap->grid_h - 1);
+	for (y = y1; y <= y2; ++y) for (x = x1; x <= x2; ++x) {
+		for (i = obsmap->cell_offsets[x + y * obsmap->grid_w]; i < obsmap->cell_offsets[x + y * obsmap->grid_w + 1]; ++i) {
+			if (test_area_line(area, obsmap->lines[obsmap->cell_lines[i]]))
+				return true;
+		}
+	}
+	return false;
+}
+
+bool
+test_obsmap_line(const obsmap_t* obsmap, rect_t line)
+{
+	int x1, y1, x2, y2;
+	
+	int i, x, y;
+
+	if (!obsmap->has_index)
+		return test_line_linear(obsmap, line);
+	
+	// only check segments sharing a grid cell with the line. the line's bounding box is
+	// padded by a pixel to allow for rounding in do_lines_intersect().
+	x1 = fmin(line.x1, line.x2) - 1 - obsmap->bounds.x1;
+	y1 = fmin(line.y1, line.y2) - 1 - obsmap->bounds.y1;
+	x2 = fmax(line.x1, line.x2) + 1 - obsmap->bounds.x1;
+	y2 = fmax(line.y1, line.y2) + 1 - obsmap->bounds.y1;
+	if (x2 < 0 || y2 < 0 || x1 >= obsmap->grid_w * obsmap->cell_size || y1 >= obsmap->grid_h * obsmap->cell_size)
+		return false;
+	x1 = fmax(x1, 0) / obsmap->cell_size;
+	y1 = fmax(y1, 0) / obsmap->cell_size;
+	x2 = fmin(x2 / obsmap->cell_size, obsmap->grid_w - 1);
+	y2 = fmin(y2 / obsmap->cell_size, obsmap->grid_h - 1);
+	for (y = y1; y <= y2; ++y) for (x = x1; x <= x2; ++x) {
+		for (i = obsmap->cell_offsets[x + y * obsmap->grid_w]; i < obsmap->cell_offsets[x + y * obsmap->grid_w + 1]; ++i) {
+			if (do_lines_intersect(line, obsmap->lines[obsmap->cell_lines[i]]))
+				return true;
+		}
 	}
 	return false;
 }
@@ -68,3 +218,36 @@ test_obsmap_rect(const obsmap_t* obsmap, rect_t rect)
 		|| test_obsmap_line(obsmap, new_rect(rect.x1, rect.y2, rect.x2, rect.y2))
 		|| test_obsmap_line(obsmap, new_rect(rect.x1, rect.y1, rect.x1, rect.y2));
 }
+
+static void
+free_obsmap_index(obsmap_t* obsmap)
+{
+	free(obsmap->cell_offsets);
+	free(obsmap->cell_lines);
+	obsmap->cell_offsets = NULL;
+	obsmap->cell_lines = NULL;
+	obsmap->has_index = false;
+}
+
+static bool
+test_area_line(rect_t area, rect_t line)
+{
+	// the area includes its right and bottom edges. single points are skipped, since
+	// do_lines_intersect() never reports them either.
+	
+	if (line.x1 == line.x2 && line.y1 == line.y2)
+		return false;
+	return clip_line(&line, new_rect(area.x1, area.y1, area.x2 + 1, area.y2 + 1));
+}
+
+static bool
+test_line_linear(const obsmap_t* obsmap, rect_t line)
+{
+	int i;
+
+	for (i = 0; i < obsmap->num_lines; ++i) {
+		if (do_lines_intersect(line, obsmap->lines[i]))
+			return true;
+	}
+	return false;
+}
@@ -3,10 +3,14 @@
 
 typedef struct obsmap obsmap_t;
 
-obsmap_t* new_obsmap       (void);
-void      free_obsmap      (obsmap_t* obsmap);
-bool      add_obsmap_line  (obsmap_t* obsmap, rect_t line);
-bool      test_obsmap_line (const obsmap_t* obsmap, rect_t line);
-bool      test_obsmap_rect (const obsmap_t* obsmap, rect_t rect);
+obsmap_t* new_obsmap            (void);
+void      free_obsmap           (obsmap_t* obsmap);
+bool      add_obsmap_line       (obsmap_t* obsmap, rect_t line);
+bool      build_obsmap_index    (obsmap_t* obsmap);
+int       get_obsmap_line_count (const obsmap_t* obsmap);
+rect_t    get_obsmap_line       (const obsmap_t* obsmap, int index);
+bool      test_obsmap_area      (const obsmap_t* obsmap, rect_t area);
+bool      test_obsmap_line      (const obsmap_t* obsmap, rect_t line);
+bool      test_obsmap_rect      (const obsmap_t* obsmap, rect_t rect);
 
 #endif // MINISPHERE__OBSMAP_H__INCLUDED
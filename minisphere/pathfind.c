@@ -0,0 +1,452 @@
+#include "minisphere.h"
+#include "api.h"
+#include "map_engine.h"
+#include "persons.h"
+
+#include "pathfind.h"
+
+enum node_flags
+{
+	NODE_BLOCKED = 0x1,
+	NODE_CLOSED  = 0x2,
+	NODE_TESTED  = 0x4
+};
+
+struct path
+{
+	int       num_points;
+	point3_t* points;
+};
+
+struct open_node
+{
+	int f, h;
+	int index;
+};
+
+struct search
+{
+	const person_t* person;
+	int             grid_w, grid_h;
+	int             tile_w, tile_h;
+	int             start, goal;
+	int             start_x, start_y;
+	int             goal_x, goal_y;
+};
+
+static duk_ret_t js_FindPath   (duk_context* ctx);
+static duk_ret_t js_FollowPath (duk_context* ctx);
+
+static bool             grow_nodes      (int num_nodes);
+static void             get_node_xy     (const struct search* search, int index, int* out_x, int* out_y);
+static struct open_node pop_open_node   (void);
+static bool             push_open_node  (int index, int f, int h);
+static bool             test_node       (const struct search* search, int index);
+static bool             test_node_edge  (const struct search* search, int from_index, int to_index);
+static void             visit_node      (int index);
+
+static unsigned int      s_search_id = 0;
+static int               s_max_nodes = 0;
+static unsigned int*     s_stamps    = NULL;
+static uint8_t*          s_flags     = NULL;
+static int*              s_costs     = NULL;
+static int*              s_parents   = NULL;
+static int               s_max_open  = 0;
+static int               s_num_open  = 0;
+static struct open_node* s_open_heap = NULL;
+
+void
+initialize_pathfinder(void)
+{
+	s_search_id = 0;
+	s_max_nodes = 0;
+	s_stamps = NULL;
+	s_flags = NULL;
+	s_costs = NULL;
+	s_parents = NULL;
+	s_max_open = s_num_open = 0;
+	s_open_heap = NULL;
+}
+
+void
+shutdown_pathfinder(void)
+{
+	free(s_stamps);
+	free(s_flags);
+	free(s_costs);
+	free(s_parents);
+	free(s_open_heap);
+}
+
+path_t*
+find_path(const person_t* person, int x, int y)
+{
+	// A* over a grid with one node per map tile. the grid is filled in lazily as the
+	// search reaches each node: the person's base is placed at the node and tested
+	// against map and tile obstructions, then against other persons (minus the
+	// ignore list). edges are tested by sweeping the base along them in one go
+	// rather than a position at a time.
+
+	static const int dx[] = { 0, 1, 0, -1 };
+	static const int dy[] = { -1, 0, 1, 0 };
+
+	rect_t           bounds;
+	int              cost;
+	rect_t           goal_base;
+	struct open_node current;
+	int              goal_cx, goal_cy;
+	int              h;
+	int              index;
+	int              layer;
+	int              neighbor;
+	int              node_x, node_y;
+	int              num_points;
+	path_t*          path = NULL;
+	double           person_x, person_y;
+	struct search    search;
+	int              step_cost;
+
+	int i;
+
+	if (!is_map_engine_running())
+		return NULL;
+	bounds = get_map_bounds();
+	if (!is_point_in_rect(x, y, bounds))
+		return NULL;
+	goal_base = get_person_sweep(person, x, y, x, y);
+	if (test_person_sweep_map(person, goal_base) || test_person_sweep_persons(person, goal_base))
+		return NULL;
+
+	// set up the search
+	get_person_xyz(person, &person_x, &person_y, &layer, true);
+	get_tile_size(get_map_tileset(), &search.tile_w, &search.tile_h);
+	search.person = person;
+	search.grid_w = bounds.x2 / search.tile_w;
+	search.grid_h = bounds.y2 / search.tile_h;
+	search.start_x = fmin(fmax(person_x, 0), bounds.x2 - 1);
+	search.start_y = fmin(fmax(person_y, 0), bounds.y2 - 1);
+	search.goal_x = x; search.goal_y = y;
+	search.start = search.start_x / search.tile_w + search.start_y / search.tile_h * search.grid_w;
+	search.goal = x / search.tile_w + y / search.tile_h * search.grid_w;
+	goal_cx = search.goal % search.grid_w;
+	goal_cy = search.goal / search.grid_w;
+	if (!grow_nodes(search.grid_w * search.grid_h))
+		return NULL;
+	if (++s_search_id == 0) {
+		// stamp counter wrapped around, stale stamps could alias the new ID
+		memset(s_stamps, 0, s_max_nodes * sizeof(unsigned int));
+		s_search_id = 1;
+	}
+	s_num_open = 0;
+	visit_node(search.start);
+	s_flags[search.start] |= NODE_TESTED;
+	s_costs[search.start] = 0;
+	if (!push_open_node(search.start, 0, 0))
+		return NULL;
+
+	// expand nodes until the goal is reached or the open list runs dry
+	while (s_num_open > 0) {
+		current = pop_open_node();
+		if (s_flags[current.index] & NODE_CLOSED)
+			continue;  // stale heap entry, node was already reached more cheaply
+		s_flags[current.index] |= NODE_CLOSED;
+		if (current.index == search.goal)
+			break;
+		node_x = current.index % search.grid_w;
+		node_y = current.index / search.grid_w;
+		for (i = 0; i < 4; ++i) {
+			if (node_x + dx[i] < 0 || node_x + dx[i] >= search.grid_w
+				|| node_y + dy[i] < 0 || node_y + dy[i] >= search.grid_h)
+			{
+				continue;
+			}
+			neighbor = current.index + dx[i] + dy[i] * search.grid_w;
+			visit_node(neighbor);
+			step_cost = dx[i] != 0 ? search.tile_w : search.tile_h;
+			cost = s_costs[current.index] + step_cost;
+			if ((s_flags[neighbor] & NODE_CLOSED) || cost >= s_costs[neighbor])
+				continue;
+			if (!test_node(&search, neighbor) || !test_node_edge(&search, current.index, neighbor))
+				continue;
+			h = abs(goal_cx - (node_x + dx[i])) * search.tile_w
+				+ abs(goal_cy - (node_y + dy[i])) * search.tile_h;
+			s_costs[neighbor] = cost;
+			s_parents[neighbor] = current.index;
+			if (!push_open_node(neighbor, cost + h, h))
+				return NULL;
+		}
+	}
+	if (s_stamps[search.goal] != s_search_id || !(s_flags[search.goal] & NODE_CLOSED))
+		return NULL;
+
+	// walk back from the goal, keeping only the nodes where the path turns. a node
+	// is only dropped when its neighbors lie on the same row or column, since
+	// walk_person() would otherwise take a different route between them.
+	num_points = 0;
+	for (index = search.goal; index != -1; index = s_parents[index])
+		++num_points;
+	if (!(path = calloc(1, sizeof(path_t)))) goto on_error;
+	if (!(path->points = calloc(num_points, sizeof(point3_t)))) goto on_error;
+	for (index = search.goal, i = num_points - 1; index != -1; index = s_parents[index], --i) {
+		get_node_xy(&search, index, &path->points[i].x, &path->points[i].y);
+		path->points[i].z = layer;
+	}
+	path->num_points = 0;
+	for (i = 0; i < num_points; ++i) {
+		if (i > 0 && i < num_points - 1
+			&& ((path->points[i - 1].x == path->points[i].x && path->points[i].x == path->points[i + 1].x)
+			|| (path->points[i - 1].y == path->points[i].y && path->points[i].y == path->points[i + 1].y)))
+		{
+			continue;
+		}
+		path->points[path->num_points++] = path->points[i];
+	}
+	return path;
+
+on_error:
+	free_path(path);
+	return NULL;
+}
+
+void
+free_path(path_t* path)
+{
+	if (path == NULL)
+		return;
+	free(path->points);
+	free(path);
+}
+
+int
+get_path_length(const path_t* path)
+{
+	return path->num_points;
+}
+
+point3_t
+get_path_point(const path_t* path, int index)
+{
+	return path->points[index];
+}
+
+void
+init_pathfind_api(void)
+{
+	register_api_func(g_duktape, NULL, "FindPath", js_FindPath);
+	register_api_func(g_duktape, NULL, "FollowPath", js_FollowPath);
+}
+
+static bool
+grow_nodes(int num_nodes)
+{
+	int*          new_costs;
+	uint8_t*      new_flags;
+	int*          new_parents;
+	unsigned int* new_stamps;
+
+	if (num_nodes <= s_max_nodes)
+		return true;
+	if (!(new_stamps = realloc(s_stamps, num_nodes * sizeof(unsigned int)))) return false;
+	s_stamps = new_stamps;
+	memset(s_stamps + s_max_nodes, 0, (num_nodes - s_max_nodes) * sizeof(unsigned int));
+	if (!(new_flags = realloc(s_flags, num_nodes))) return false;
+	s_flags = new_flags;
+	if (!(new_costs = realloc(s_costs, num_nodes * sizeof(int)))) return false;
+	s_costs = new_costs;
+	if (!(new_parents = realloc(s_parents, num_nodes * sizeof(int)))) return false;
+	s_parents = new_parents;
+	s_max_nodes = num_nodes;
+	return true;
+}
+
+static void
+get_node_xy(const struct search* search, int index, int* out_x, int* out_y)
+{
+	// the start and goal nodes stand for the exact endpoints rather than the
+	// centers of their tiles
+
+	if (index == search->goal) {
+		*out_x = search->goal_x; *out_y = search->goal_y;
+	}
+	else if (index == search->start) {
+		*out_x = search->start_x; *out_y = search->start_y;
+	}
+	else {
+		*out_x = index % search->grid_w * search->tile_w + search->tile_w / 2;
+		*out_y = index / search->grid_w * search->tile_h + search->tile_h / 2;
+	}
+}
+
+static struct open_node
+pop_open_node(void)
+{
+	struct open_node node;
+	int              child;
+	struct open_node last;
+	int              parent;
+
+	node = s_open_heap[0];
+	last = s_open_heap[--s_num_open];
+	parent = 0;
+	while ((child = parent * 2 + 1) < s_num_open) {
+		if (child + 1 < s_num_open
+			&& (s_open_heap[child + 1].f < s_open_heap[child].f
+			|| (s_open_heap[child + 1].f == s_open_heap[child].f && s_open_heap[child + 1].h < s_open_heap[child].h)))
+		{
+			++child;
+		}
+		if (last.f < s_open_heap[child].f || (last.f == s_open_heap[child].f && last.h <= s_open_heap[child].h))
+			break;
+		s_open_heap[parent] = s_open_heap[child];
+		parent = child;
+	}
+	s_open_heap[parent] = last;
+	return node;
+}
+
+static bool
+push_open_node(int index, int f, int h)
+{
+	// ties on f are broken toward the lower heuristic, i.e. the node closer to
+	// the goal, which keeps A* from fanning out across open ground
+
+	int               child;
+	struct open_node* new_heap;
+	int               parent;
+
+	if (++s_num_open > s_max_open) {
+		s_max_open = s_num_open * 2;
+		if (!(new_heap = realloc(s_open_heap, s_max_open * sizeof(struct open_node))))
+			return false;
+		s_open_heap = new_heap;
+	}
+	child = s_num_open - 1;
+	while (child > 0) {
+		parent = (child - 1) / 2;
+		if (s_open_heap[parent].f < f || (s_open_heap[parent].f == f && s_open_heap[parent].h <= h))
+			break;
+		s_open_heap[child] = s_open_heap[parent];
+		child = parent;
+	}
+	s_open_heap[child].f = f;
+	s_open_heap[child].h = h;
+	s_open_heap[child].index = index;
+	return true;
+}
+
+static bool
+test_node(const struct search* search, int index)
+{
+	rect_t base;
+	int    x, y;
+
+	if (!(s_flags[index] & NODE_TESTED)) {
+		get_node_xy(search, index, &x, &y);
+		base = get_person_sweep(search->person, x, y, x, y);
+		if (test_person_sweep_map(search->person, base) || test_person_sweep_persons(search->person, base))
+			s_flags[index] |= NODE_BLOCKED;
+		s_flags[index] |= NODE_TESTED;
+	}
+	return !(s_flags[index] & NODE_BLOCKED);
+}
+
+static bool
+test_node_edge(const struct search* search, int from_index, int to_index)
+{
+	// both endpoints have already been tested. the route is x first, then y, the
+	// same way walk_person() moves, so edges to the off-grid start and goal points
+	// are checked along the path that will actually be walked. the base is swept
+	// over each leg as a whole, so no obstruction can slip through between two
+	// positions of it.
+
+	rect_t sweep;
+	int    x1, y1, x2, y2;
+
+	get_node_xy(search, from_index, &x1, &y1);
+	get_node_xy(search, to_index, &x2, &y2);
+	if (x1 != x2) {
+		sweep = get_person_sweep(search->person, x1, y1, x2, y1);
+		if (test_person_sweep_map(search->person, sweep) || test_person_sweep_persons(search->person, sweep))
+			return false;
+	}
+	if (y1 != y2) {
+		sweep = get_person_sweep(search->person, x2, y1, x2, y2);
+		if (test_person_sweep_map(search->person, sweep) || test_person_sweep_persons(search->person, sweep))
+			return false;
+	}
+	return true;
+}
+
+static void
+visit_node(int index)
+{
+	if (s_stamps[index] == s_search_id)
+		return;
+	s_stamps[index] = s_search_id;
+	s_flags[index] = 0x0;
+	s_costs[index] = INT_MAX;
+	s_parents[index] = -1;
+}
+
+static duk_ret_t
+js_FindPath(duk_context* ctx)
+{
+	const char* name = duk_require_string(ctx, 0);
+	int x = duk_require_int(ctx, 1);
+	int y = duk_require_int(ctx, 2);
+
+	path_t*   path;
+	person_t* person;
+	point3_t  point;
+
+	int i;
+
+	if (!is_map_engine_running())
+		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "FindPath(): Map engine must be running");
+	if ((person = find_person(name)) == NULL)
+		duk_error_ni(ctx, -1, DUK_ERR_REFERENCE_ERROR, "FindPath(): Person '%s' doesn't exist", name);
+	if ((path = find_path(person, x, y)) == NULL) {
+		duk_push_null(ctx);
+		return 1;
+	}
+	duk_push_array(ctx);
+	for (i = 0; i < get_path_length(path); ++i) {
+		point = get_path_point(path, i);
+		duk_push_object(ctx);
+		duk_push_int(ctx, point.x); duk_put_prop_string(ctx, -2, "x");
+		duk_push_int(ctx, point.y); duk_put_prop_string(ctx, -2, "y");
+		duk_put_prop_index(ctx, -2, i);
+	}
+	free_path(path);
+	return 1;
+}
+
+static duk_ret_t
+js_FollowPath(duk_context* ctx)
+{
+	const char* name = duk_require_string(ctx, 0);
+
+	int       num_points;
+	person_t* person;
+	int       x, y;
+
+	int i;
+
+	// each waypoint becomes a COMMAND_MOVE_TO. walk_person() covers x first and
+	// then y, the same route test_node_edge() checked.
+	if ((person = find_person(name)) == NULL)
+		duk_error_ni(ctx, -1, DUK_ERR_REFERENCE_ERROR, "FollowPath(): Person '%s' doesn't exist", name);
+	duk_require_object_coercible(ctx, 1);
+	if (!duk_is_array(ctx, 1))
+		duk_error_ni(ctx, -1, DUK_ERR_RANGE_ERROR, "FollowPath(): path argument must be an array");
+	num_points = duk_get_length(ctx, 1);
+	for (i = 0; i < num_points; ++i) {
+		duk_get_prop_index(ctx, 1, i);
+		duk_get_prop_string(ctx, -1, "x"); x = duk_require_int(ctx, -1); duk_pop(ctx);
+		duk_get_prop_string(ctx, -1, "y"); y = duk_require_int(ctx, -1); duk_pop(ctx);
+		duk_pop(ctx);
+		if (!queue_person_move(person, x, y, false))
+			duk_error_ni(ctx, -1, DUK_ERR_ERROR, "FollowPath(): Failed to enlarge person's command queue (internal error)");
+	}
+	return 0;
+}
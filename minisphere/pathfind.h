@@ -0,0 +1,17 @@
+#ifndef MINISPHERE__PATHFIND_H__INCLUDED
+#define MINISPHERE__PATHFIND_H__INCLUDED
+
+#include "persons.h"
+
+typedef struct path path_t;
+
+extern void     initialize_pathfinder (void);
+extern void     shutdown_pathfinder   (void);
+extern path_t*  find_path             (const person_t* person, int x, int y);
+extern void     free_path             (path_t* path);
+extern int      get_path_length       (const path_t* path);
+extern point3_t get_path_point        (const path_t* path, int index);
+
+extern void init_pathfind_api (void);
+
+#endif // MINISPHERE__PATHFIND_H__INCLUDED
@@ -7,11 +7,14 @@
 
 #include "persons.h"
 
+#define PERSON_CELL_SIZE 64
+#define PERSON_HASH_SIZE 4096
+
 struct person
 {
 	char*          name;
 	int            anim_frames;
-	char*          direction;
+	int            direction_id;
 	int            frame;
 	bool           has_moved;
 	bool           ignore_all_persons;
@@ -20,6 +23,7 @@ struct person
 	bool           is_visible;
 	int            layer;
 	color_t        mask;
+	int            pose_index;
 	int            revert_delay;
 	int            revert_frames;
 	double         scale_x;
@@ -30,11 +34,18 @@ struct person
 	double         theta;
 	double         x, y;
 	int            x_offset, y_offset;
+	int            first_command;
 	int            max_commands;
 	int            num_ignores;
 	int            num_commands;
 	struct command *commands;
 	char*          *ignores;
+	bool           is_hash_dirty;
+	int            hash_key;
+	person_t*      hash_prev;
+	person_t*      hash_next;
+	person_t*      name_next;
+	int            sort_index;
 };
 
 struct command
@@ -42,6 +53,7 @@ struct command
 	int type;
 	bool is_immediate;
 	int script_id;
+	double x, y;
 };
 
 static duk_ret_t js_CreatePerson                 (duk_context* ctx);
@@ -71,11 +83,13 @@ static duk_ret_t js_GetPersonOffsetY             (duk_context* ctx);
 static duk_ret_t js_GetPersonSpeedX              (duk_context* ctx);
 static duk_ret_t js_GetPersonSpeedY              (duk_context* ctx);
 static duk_ret_t js_GetPersonSpriteset           (duk_context* ctx);
+static duk_ret_t js_GetPersonStates              (duk_context* ctx);
 static duk_ret_t js_GetPersonValue               (duk_context* ctx);
 static duk_ret_t js_GetPersonX                   (duk_context* ctx);
 static duk_ret_t js_GetPersonY                   (duk_context* ctx);
 static duk_ret_t js_GetPersonXFloat              (duk_context* ctx);
 static duk_ret_t js_GetPersonYFloat              (duk_context* ctx);
+static duk_ret_t js_GetPoseID                    (duk_context* ctx);
 static duk_ret_t js_GetTalkDistance              (duk_context* ctx);
 static duk_ret_t js_SetDefaultPersonScript       (duk_context* ctx);
 static duk_ret_t js_SetPersonAngle               (duk_context* ctx);
@@ -106,21 +120,50 @@ static duk_ret_t js_ClearPersonCommands          (duk_context* ctx);
 static duk_ret_t js_IgnorePersonObstructions     (duk_context* ctx);
 static duk_ret_t js_IgnoreTileObstructions       (duk_context* ctx);
 static duk_ret_t js_QueuePersonCommand           (duk_context* ctx);
+static duk_ret_t js_QueuePersonMove              (duk_context* ctx);
 static duk_ret_t js_QueuePersonScript            (duk_context* ctx);
 
-static void command_person       (person_t* person, int command);
-static int  compare_persons      (const void* a, const void* b);
-static void free_person          (person_t* person);
-static void set_person_direction (person_t* person, const char* direction);
-static void set_person_name      (person_t* person, const char* name);
-static void sort_persons         (void);
-
-static const person_t* s_current_person = NULL;
+static void            command_person          (person_t* person, int command);
+static int             compare_persons         (const void* a, const void* b);
+static person_t*       find_obstructing_person (const person_t* person, int layer, rect_t rect);
+static void            free_person             (person_t* person);
+static int             hash_person_cell        (int layer, int cell_x, int cell_y);
+static unsigned int    hash_person_name        (const char* name);
+static void            index_person_name       (person_t* person);
+static void            mark_person_moved       (person_t* person);
+static bool            move_person             (person_t* person, double new_x, double new_y);
+static struct command* push_person_command     (person_t* person);
+static void            rehash_person           (person_t* person);
+static void            reposition_person       (person_t* person);
+static bool            set_person_direction    (person_t* person, const char* direction);
+static void            set_person_name         (person_t* person, const char* name);
+static void            sort_persons            (void);
+static person_t*       test_person_bucket      (int key, const person_t* person, int layer, rect_t rect, person_t* obs_person);
+static void            unhash_person           (person_t* person);
+static void            unindex_person_name     (person_t* person);
+static bool            update_draw_lists       (void);
+static void            update_person_hash      (void);
+static bool            walk_person             (person_t* person, double x, double y);
+
+static const person_t* s_current_person  = NULL;
 static int             s_def_scripts[PERSON_SCRIPT_MAX];
-static int             s_talk_distance  = 8;
-static int             s_max_persons    = 0;
-static int             s_num_persons    = 0;
-static person_t*       *s_persons       = NULL;
+static int             s_talk_distance   = 8;
+static int             s_max_persons     = 0;
+static int             s_num_persons     = 0;
+static person_t*       *s_persons        = NULL;
+static person_t*       s_hash_buckets[PERSON_HASH_SIZE];
+static int             s_hash_max_w      = 0;
+static int             s_hash_max_h      = 0;
+static int             s_max_dirty       = 0;
+static int             s_num_dirty       = 0;
+static person_t*       *s_dirty_persons  = NULL;
+static bool            s_need_rehash_all = false;
+static bool            s_need_draw_lists = true;
+static int             s_num_draw_layers = 0;
+static int*            s_draw_starts     = NULL;
+static person_t*       *s_draw_list      = NULL;
+static int             s_name_slots      = 0;
+static person_t*       *s_name_index     = NULL;
 
 void
 initialize_persons_manager(void)
@@ -130,6 +173,17 @@ initialize_persons_manager(void)
 	s_persons = NULL;
 	s_talk_distance = 8;
 	s_current_person = NULL;
+	memset(s_hash_buckets, 0, PERSON_HASH_SIZE * sizeof(person_t*));
+	s_hash_max_w = s_hash_max_h = 0;
+	s_num_dirty = s_max_dirty = 0;
+	s_dirty_persons = NULL;
+	s_need_rehash_all = false;
+	s_need_draw_lists = true;
+	s_num_draw_layers = 0;
+	s_draw_starts = NULL;
+	s_draw_list = NULL;
+	s_name_slots = 0;
+	s_name_index = NULL;
 }
 
 void
@@ -139,7 +193,13 @@ shutdown_persons_manager(void)
 	
 	for (i = 0; i < s_num_persons; ++i)
 		free_person(s_persons[i]);
+	for (i = 0; i < PERSON_SCRIPT_MAX; ++i)
+		free_script(s_def_scripts[i]);
 	free(s_persons);
+	free(s_dirty_persons);
+	free(s_draw_starts);
+	free(s_draw_list);
+	free(s_name_index);
 }
 
 person_t*
@@ -155,8 +215,9 @@ create_person(const char* name, const char* sprite_file, bool is_persistent)
 	}
 	person = s_persons[s_num_persons - 1] = calloc(1, sizeof(person_t));
 	set_person_name(person, name);
+	index_person_name(person);
 	path = get_asset_path(sprite_file, "spritesets", false);
-	person->sprite = load_spriteset(path);
+	person->sprite = load_shared_spriteset(path);
 	free(path);
 	set_person_direction(person, person->sprite->poses[0].name->cstr);
 	person->is_persistent = is_persistent;
@@ -166,10 +227,13 @@ create_person(const char* name, const char* sprite_file, bool is_persistent)
 	person->layer = map_origin.z;
 	person->speed_x = 1.0;
 	person->speed_y = 1.0;
-	person->anim_frames = get_sprite_frame_delay(person->sprite, person->direction, 0);
+	person->anim_frames = get_sprite_frame_delay(person->sprite, person->pose_index, 0);
 	person->mask = rgba(255, 255, 255, 255);
 	person->scale_x = person->scale_y = 1.0;
-	sort_persons();
+	person->hash_key = -1;
+	person->sort_index = s_num_persons - 1;
+	mark_person_moved(person);
+	reposition_person(person);
 	return person;
 }
 
@@ -182,11 +246,14 @@ destroy_person(person_t* person)
 	free_person(person);
 	for (i = 0; i < s_num_persons; ++i) {
 		if (s_persons[i] == person) {
-			for (j = i; j < s_num_persons - 1; ++j) s_persons[j] = s_persons[j + 1];
+			for (j = i; j < s_num_persons - 1; ++j) {
+				s_persons[j] = s_persons[j + 1];
+				s_persons[j]->sort_index = j;
+			}
 			--s_num_persons; --i;
 		}
 	}
-	sort_persons();
+	s_need_draw_lists = true;
 }
 
 bool
@@ -220,16 +287,12 @@ is_person_ignored(const person_t* person, const person_t* by_person)
 bool
 is_person_obstructed_at(const person_t* person, double x, double y, person_t** out_obstructing_person, int* out_tile_index)
 {
-	rect_t           area;
-	rect_t           base, my_base;
-	double           cur_x, cur_y;
-	bool             is_obstructed = false;
-	int              layer;
-	const obsmap_t*  obsmap;
-	int              tile_w, tile_h;
-	const tileset_t* tileset;
-
-	int i, i_x, i_y;
+	rect_t          my_base;
+	double          cur_x, cur_y;
+	bool            is_obstructed = false;
+	int             layer;
+	person_t*       obs_person;
+	const obsmap_t* obsmap;
 	
 	normalize_map_entity_xy(&x, &y, person->layer);
 	get_person_xyz(person, &cur_x, &cur_y, &layer, true);
@@ -239,16 +302,9 @@ is_person_obstructed_at(const person_t* person, double x, double y, person_t** o
 
 	// check for obstructing persons
 	if (!person->ignore_all_persons) {
-		for (i = 0; i < s_num_persons; ++i) {
-			if (s_persons[i] == person) continue;  // these persons aren't going to obstruct themselves
-			if (s_persons[i]->layer != layer) continue;  // ignore persons not on the same layer
-			if (is_person_ignored(person, s_persons[i])) continue;
-			base = get_person_base(s_persons[i]);
-			if (do_rects_intersect(my_base, base)) {
-				is_obstructed = true;
-				if (out_obstructing_person) *out_obstructing_person = s_persons[i];
-				break;
-			}
+		if ((obs_person = find_obstructing_person(person, layer, my_base)) != NULL) {
+			is_obstructed = true;
+			if (out_obstructing_person) *out_obstructing_person = obs_person;
 		}
 	}
 
@@ -257,24 +313,9 @@ is_person_obstructed_at(const person_t* person, double x, double y, person_t** o
 	if (test_obsmap_rect(obsmap, my_base))
 		is_obstructed = true;
 	
-	// check for obstructing tiles; constrain search to immediate vicinity of sprite base
-	if (!person->ignore_all_tiles) {
-		tileset = get_map_tileset();
-		get_tile_size(tileset, &tile_w, &tile_h);
-		area.x1 = my_base.x1 / tile_w;
-		area.y1 = my_base.y1 / tile_h;
-		area.x2 = area.x1 + (my_base.x2 - my_base.x1) / tile_w + 2;
-		area.y2 = area.y1 + (my_base.y2 - my_base.y1) / tile_h + 2;
-		for (i_x = area.x1; i_x < area.x2; ++i_x) for (i_y = area.y1; i_y < area.y2; ++i_y) {
-			base = translate_rect(my_base, -(i_x * tile_w), -(i_y * tile_h));
-			obsmap = get_tile_obsmap(tileset, get_map_tile(i_x, i_y, layer));
-			if (obsmap != NULL && test_obsmap_rect(obsmap, base)) {
-				is_obstructed = true;
-				if (out_tile_index) *out_tile_index = get_map_tile(i_x, i_y, layer);
-				break;
-			}
-		}
-	}
+	// check for obstructing tiles
+	if (!person->ignore_all_tiles && test_map_tile_obs(layer, my_base, out_tile_index))
+		is_obstructed = true;
 	
 	return is_obstructed;
 }
@@ -333,6 +374,23 @@ get_person_spriteset(person_t* person)
 	return person->sprite;
 }
 
+rect_t
+get_person_sweep(const person_t* person, double x1, double y1, double x2, double y2)
+{
+	// the area the person's base covers moving from (x1, y1) to (x2, y2) along one
+	// axis. a zero-length move gives just the base at that spot.
+	
+	rect_t base;
+	double cur_x, cur_y;
+	rect_t from, to;
+
+	get_person_xy(person, &cur_x, &cur_y, true);
+	base = get_person_base(person);
+	from = translate_rect(base, x1 - cur_x, y1 - cur_y);
+	to = translate_rect(base, x2 - cur_x, y2 - cur_y);
+	return new_rect(fmin(from.x1, to.x1), fmin(from.y1, to.y1), fmax(from.x2, to.x2), fmax(from.y2, to.y2));
+}
+
 void
 get_person_xy(const person_t* person, double* out_x, double* out_y, bool want_normalize)
 {
@@ -369,6 +427,7 @@ set_person_scale(person_t* person, double scale_x, double scale_y)
 {
 	person->scale_x = scale_x;
 	person->scale_y = scale_y;
+	mark_person_moved(person);
 }
 
 bool
@@ -411,9 +470,11 @@ set_person_spriteset(person_t* person, spriteset_t* spriteset)
 	
 	old_spriteset = person->sprite;
 	person->sprite = ref_spriteset(spriteset);
-	person->anim_frames = get_sprite_frame_delay(person->sprite, person->direction, 0);
+	person->pose_index = find_sprite_pose(person->sprite, person->direction_id);
+	person->anim_frames = get_sprite_frame_delay(person->sprite, person->pose_index, 0);
 	person->frame = 0;
 	free_spriteset(old_spriteset);
+	mark_person_moved(person);
 }
 
 void
@@ -422,7 +483,8 @@ set_person_xyz(person_t* person, double x, double y, int layer)
 	person->x = x;
 	person->y = y;
 	person->layer = layer;
-	sort_persons();
+	mark_person_moved(person);
+	reposition_person(person);
 }
 
 bool
@@ -442,70 +504,121 @@ call_person_script(const person_t* person, int type, bool use_default)
 person_t*
 find_person(const char* name)
 {
+	// as before the name index was added, if several persons share a name the one
+	// earliest in s_persons wins
+	person_t* match = NULL;
+	person_t* person;
+	
 	int i;
-
-	for (i = 0; i < s_num_persons; ++i) {
-		if (strcmp(name, s_persons[i]->name) == 0)
-			return s_persons[i];
+	
+	if (s_name_slots == 0) {
+		for (i = 0; i < s_num_persons; ++i)
+			if (strcmp(name, s_persons[i]->name) == 0) return s_persons[i];
+		return NULL;
+	}
+	person = s_name_index[hash_person_name(name) & (s_name_slots - 1)];
+	for (; person != NULL; person = person->name_next) {
+		if (strcmp(name, person->name) == 0 && (match == NULL || person->sort_index < match->sort_index))
+			match = person;
 	}
-	return NULL;
+	return match;
 }
 
 bool
 queue_person_command(person_t* person, int command, bool is_immediate)
 {
-	++person->num_commands;
-	if (person->num_commands > person->max_commands) {
-		if (!(person->commands = realloc(person->commands, person->num_commands * sizeof(struct command))))
-			return false;
-		person->max_commands = person->num_commands;
-	}
-	person->commands[person->num_commands - 1].type = command;
-	person->commands[person->num_commands - 1].is_immediate = is_immediate;
-	person->commands[person->num_commands - 1].script_id = 0;
+	struct command* p_command;
+	
+	if ((p_command = push_person_command(person)) == NULL)
+		return false;
+	p_command->type = command;
+	p_command->is_immediate = is_immediate;
+	p_command->script_id = 0;
+	return true;
+}
+
+bool
+queue_person_move(person_t* person, double x, double y, bool is_immediate)
+{
+	struct command* p_command;
+
+	if ((p_command = push_person_command(person)) == NULL)
+		return false;
+	p_command->type = COMMAND_MOVE_TO;
+	p_command->is_immediate = is_immediate;
+	p_command->script_id = 0;
+	p_command->x = x;
+	p_command->y = y;
 	return true;
 }
 
 bool
 queue_person_script(person_t* person, lstring_t* script, bool is_immediate)
 {
-	lstring_t* script_name;
+	struct command* p_command;
+	lstring_t*      script_name;
 	
-	++person->num_commands;
-	if (person->num_commands > person->max_commands) {
-		if (!(person->commands = realloc(person->commands, person->num_commands * sizeof(struct command))))
-			return false;
-		person->max_commands = person->num_commands;
-	}
-	if ((script_name = malloc(strlen(person->name) + 19)) == NULL)
+	if ((script_name = new_lstring("[%s : queued script]", person->name)) == NULL)
 		return false;
-	script_name = new_lstring("[%s : queued script]", person->name);
-	person->commands[person->num_commands - 1].type = COMMAND_RUN_SCRIPT;
-	person->commands[person->num_commands - 1].is_immediate = is_immediate;
-	person->commands[person->num_commands - 1].script_id = compile_script(script, script_name->cstr);
+	if ((p_command = push_person_command(person)) == NULL)
+		goto on_error;
+	p_command->type = COMMAND_RUN_SCRIPT;
+	p_command->is_immediate = is_immediate;
+	p_command->script_id = compile_script(script, script_name->cstr);
+	free_lstring(script_name);
 	return true;
+
+on_error:
+	free_lstring(script_name);
+	return false;
 }
 
 void
 render_persons(int layer, bool is_flipped, int cam_x, int cam_y)
 {
+	rect_t       base;
+	double       center_x, center_y;
 	person_t*    person;
+	double       radius;
 	spriteset_t* sprite;
+	int          start, end;
+	bool         use_lists;
 	int          w, h;
 	double       x, y;
 	int          i;
 
-	for (i = 0; i < s_num_persons; ++i) {
-		person = s_persons[i];
+	// if the draw lists can't be rebuilt, fall back on scanning everyone in depth order
+	use_lists = !s_need_draw_lists || update_draw_lists();
+	if (use_lists) {
+		if (layer >= s_num_draw_layers)
+			return;
+		start = s_draw_starts[layer];
+		end = s_draw_starts[layer + 1];
+	}
+	else {
+		start = 0;
+		end = s_num_persons;
+	}
+	for (i = start; i < end; ++i) {
+		person = use_lists ? s_draw_list[i] : s_persons[i];
 		if (!person->is_visible || person->layer != layer)
 			continue;
 		sprite = person->sprite;
-		get_sprite_size(sprite, &w, &h);
+		get_sprite_frame_size(sprite, person->pose_index, person->frame, &w, &h);
 		get_person_xy(person, &x, &y, true);
 		x -= cam_x - person->x_offset;
 		y -= cam_y - person->y_offset;
+		
+		// cull offscreen sprites. the circle around the image center covers the
+		// sprite at any angle, so rotated persons aren't clipped early.
+		base = get_sprite_base(sprite);
+		center_x = x - (base.x1 + base.x2) / 2 + w / 2.0;
+		center_y = (is_flipped ? y : y - (base.y1 + base.y2) / 2) + h / 2.0;
+		radius = sqrt(w * w * person->scale_x * person->scale_x + h * h * person->scale_y * person->scale_y) / 2;
+		if (center_x + radius < 0 || center_x - radius > g_res_x || center_y + radius < 0 || center_y - radius > g_res_y)
+			continue;
 		draw_sprite(sprite, person->mask, is_flipped, person->theta, person->scale_x, person->scale_y,
-			person->direction, x, y, person->frame);
+			person->pose_index, x, y, person->frame);
 	}
 }
 
@@ -524,34 +637,43 @@ reset_persons(bool keep_existing)
 			person->x = map_origin.x;
 			person->y = map_origin.y;
 			person->layer = map_origin.z;
+			mark_person_moved(person);
 			call_person_script(person, PERSON_SCRIPT_ON_CREATE, true);
 		}
 		else {
 			call_person_script(person, PERSON_SCRIPT_ON_DESTROY, true);
 			free_person(person);
 			--s_num_persons;
-			for (j = i; j < s_num_persons; ++j) s_persons[j] = s_persons[j + 1];
+			for (j = i; j < s_num_persons; ++j) {
+				s_persons[j] = s_persons[j + 1];
+				s_persons[j]->sort_index = j;
+			}
 			--i;
 		}
 	}
+	
+	// every surviving person was marked above, so the extents can be recomputed
+	s_hash_max_w = s_hash_max_h = 0;
 	sort_persons();
 }
 
 void
 talk_person(const person_t* person)
 {
-	rect_t    map_rect;
-	person_t* target_person;
-	double    talk_x, talk_y;
+	const char* direction;
+	rect_t      map_rect;
+	person_t*   target_person;
+	double      talk_x, talk_y;
 
 	map_rect = get_map_bounds();
 	
 	// check if anyone else is within earshot
 	get_person_xy(person, &talk_x, &talk_y, true);
-	if (strstr(person->direction, "north") != NULL) talk_y -= s_talk_distance;
-	if (strstr(person->direction, "east") != NULL) talk_x += s_talk_distance;
-	if (strstr(person->direction, "south") != NULL) talk_y += s_talk_distance;
-	if (strstr(person->direction, "west") != NULL) talk_x -= s_talk_distance;
+	direction = get_pose_name(person->direction_id);
+	if (strstr(direction, "north") != NULL) talk_y -= s_talk_distance;
+	if (strstr(direction, "east") != NULL) talk_x += s_talk_distance;
+	if (strstr(direction, "south") != NULL) talk_y += s_talk_distance;
+	if (strstr(direction, "west") != NULL) talk_x -= s_talk_distance;
 	is_person_obstructed_at(person, talk_x, talk_y, &target_person, NULL);
 	
 	// if so, call their talk script
@@ -559,6 +681,28 @@ talk_person(const person_t* person)
 		call_person_script(target_person, PERSON_SCRIPT_ON_TALK, true);
 }
 
+bool
+test_person_sweep_map(const person_t* person, rect_t sweep)
+{
+	// map-defined and tile obstructions only. these don't change while a path is
+	// being searched, which is why they're tested apart from persons.
+	
+	if (test_obsmap_area(get_map_layer_obsmap(person->layer), sweep))
+		return true;
+	return !person->ignore_all_tiles && test_map_tile_area(person->layer, sweep);
+}
+
+bool
+test_person_sweep_persons(const person_t* person, rect_t sweep)
+{
+	// a rect swept along one axis is still a rect, so this covers the whole move
+	// with one lookup
+	
+	if (person->ignore_all_persons)
+		return false;
+	return find_obstructing_person(person, person->layer, sweep) != NULL;
+}
+
 void
 update_persons(void)
 {
@@ -567,7 +711,7 @@ update_persons(void)
 	const person_t* last_person;
 	person_t*       person;
 	
-	int i, j;
+	int i;
 
 	for (i = 0; i < s_num_persons; ++i) {
 		person = s_persons[i];
@@ -580,13 +724,22 @@ update_persons(void)
 		// run through the command queue, stopping after the first non-immediate command
 		is_finished = person->num_commands == 0;
 		while (!is_finished) {
-			command = person->commands[0];
+			command = person->commands[person->first_command];
+			person->first_command = (person->first_command + 1) & (person->max_commands - 1);
 			--person->num_commands;
-			for (j = 0; j < person->num_commands; ++j)
-				person->commands[j] = person->commands[j + 1];
 			last_person = s_current_person;
 			s_current_person = person;
-			if (command.type != COMMAND_RUN_SCRIPT)
+			if (command.type == COMMAND_MOVE_TO) {
+				if (!walk_person(person, command.x, command.y)) {
+					// still on the way there, put the command back at the head of the
+					// queue. no scripts ran, so the slot it came from is still free.
+					person->first_command = (person->first_command - 1) & (person->max_commands - 1);
+					++person->num_commands;
+					s_current_person = last_person;
+					break;
+				}
+			}
+			else if (command.type != COMMAND_RUN_SCRIPT)
 				command_person(person, command.type);
 			else
 				run_script(command.script_id, false);
@@ -630,11 +783,13 @@ init_persons_api(void)
 	register_api_func(g_duktape, NULL, "GetPersonSpeedX", js_GetPersonSpeedX);
 	register_api_func(g_duktape, NULL, "GetPersonSpeedY", js_GetPersonSpeedY);
 	register_api_func(g_duktape, NULL, "GetPersonSpriteset", js_GetPersonSpriteset);
+	register_api_func(g_duktape, NULL, "GetPersonStates", js_GetPersonStates);
 	register_api_func(g_duktape, NULL, "GetPersonValue", js_GetPersonValue);
 	register_api_func(g_duktape, NULL, "GetPersonX", js_GetPersonX);
 	register_api_func(g_duktape, NULL, "GetPersonXFloat", js_GetPersonXFloat);
 	register_api_func(g_duktape, NULL, "GetPersonY", js_GetPersonY);
 	register_api_func(g_duktape, NULL, "GetPersonYFloat", js_GetPersonYFloat);
+	register_api_func(g_duktape, NULL, "GetPoseID", js_GetPoseID);
 	register_api_func(g_duktape, NULL, "GetTalkDistance", js_GetTalkDistance);
 	register_api_func(g_duktape, NULL, "SetDefaultPersonScript", js_SetDefaultPersonScript);
 	register_api_func(g_duktape, NULL, "SetPersonAngle", js_SetPersonAngle);
@@ -665,6 +820,7 @@ init_persons_api(void)
 	register_api_func(g_duktape, NULL, "IgnorePersonObstructions", js_IgnorePersonObstructions);
 	register_api_func(g_duktape, NULL, "IgnoreTileObstructions", js_IgnoreTileObstructions);
 	register_api_func(g_duktape, NULL, "QueuePersonCommand", js_QueuePersonCommand);
+	register_api_func(g_duktape, NULL, "QueuePersonMove", js_QueuePersonMove);
 	register_api_func(g_duktape, NULL, "QueuePersonScript", js_QueuePersonScript);
 
 	// movement script specifier constants
@@ -704,24 +860,219 @@ compare_persons(const void* a, const void* b)
 	return (p1->y + p1->y_offset) - (p2->y + p2->y_offset);
 }
 
+static person_t*
+find_obstructing_person(const person_t* person, int layer, rect_t rect)
+{
+	int       cell_x1, cell_y1, cell_x2, cell_y2;
+	int       key;
+	person_t* obs_person = NULL;
+	
+	int x, y;
+
+	// persons are hashed by the center of their base, so widen the search by the
+	// largest base seen to catch anyone overlapping the rect from a neighboring cell
+	update_person_hash();
+	cell_x1 = floor((double)(rect.x1 - s_hash_max_w) / PERSON_CELL_SIZE);
+	cell_y1 = floor((double)(rect.y1 - s_hash_max_h) / PERSON_CELL_SIZE);
+	cell_x2 = floor((double)(rect.x2 + s_hash_max_w) / PERSON_CELL_SIZE);
+	cell_y2 = floor((double)(rect.y2 + s_hash_max_h) / PERSON_CELL_SIZE);
+	if ((double)(cell_x2 - cell_x1 + 1) * (cell_y2 - cell_y1 + 1) > PERSON_HASH_SIZE) {
+		for (key = 0; key < PERSON_HASH_SIZE; ++key)
+			obs_person = test_person_bucket(key, person, layer, rect, obs_person);
+	}
+	else {
+		for (y = cell_y1; y <= cell_y2; ++y) for (x = cell_x1; x <= cell_x2; ++x) {
+			key = hash_person_cell(layer, x, y);
+			obs_person = test_person_bucket(key, person, layer, rect, obs_person);
+		}
+	}
+	return obs_person;
+}
+
 static void
 free_person(person_t* person)
 {
 	int i;
 
+	unhash_person(person);
+	unindex_person_name(person);
+	if (person->is_hash_dirty) {
+		for (i = 0; i < s_num_dirty; ++i) {
+			if (s_dirty_persons[i] == person) {
+				s_dirty_persons[i] = s_dirty_persons[--s_num_dirty];
+				break;
+			}
+		}
+	}
 	for (i = 0; i < PERSON_SCRIPT_MAX; ++i)
 		free_script(person->scripts[i]);
 	free_spriteset(person->sprite);
+	free(person->commands);
 	free(person->name);
-	free(person->direction);
 	free(person);
 }
 
+static int
+hash_person_cell(int layer, int cell_x, int cell_y)
+{
+	unsigned int hash;
+
+	hash = ((unsigned int)cell_x * 73856093U) ^ ((unsigned int)cell_y * 19349663U)
+		^ ((unsigned int)layer * 83492791U);
+	return hash & (PERSON_HASH_SIZE - 1);
+}
+
+static unsigned int
+hash_person_name(const char* name)
+{
+	// FNV-1a
+	unsigned int hash = 2166136261U;
+	
+	while (*name != '\0')
+		hash = (hash ^ (unsigned char)*name++) * 16777619U;
+	return hash;
+}
+
+static void
+index_person_name(person_t* person)
+{
+	int        key;
+	person_t*  *new_index;
+	int        num_slots;
+	
+	int i;
+
+	// keep the load factor at or below 1, rehashing everyone as the table grows.
+	// if the new table can't be allocated the old one is kept, just with longer
+	// chains; if there's no table at all, find_person() falls back on a linear scan
+	// and the next successful rebuild picks everyone up from s_persons.
+	if (s_num_persons > s_name_slots) {
+		num_slots = s_name_slots > 0 ? s_name_slots * 2 : 64;
+		while (num_slots < s_num_persons) num_slots *= 2;
+		if ((new_index = calloc(num_slots, sizeof(person_t*))) != NULL) {
+			free(s_name_index);
+			s_name_index = new_index;
+			s_name_slots = num_slots;
+			for (i = 0; i < s_num_persons; ++i) {
+				if (s_persons[i] == person) continue;
+				key = hash_person_name(s_persons[i]->name) & (s_name_slots - 1);
+				s_persons[i]->name_next = s_name_index[key];
+				s_name_index[key] = s_persons[i];
+			}
+		}
+	}
+	if (s_name_slots == 0) return;
+	key = hash_person_name(person->name) & (s_name_slots - 1);
+	person->name_next = s_name_index[key];
+	s_name_index[key] = person;
+}
+
 static void
+mark_person_moved(person_t* person)
+{
+	// rehashing is deferred until the next collision check, since a person's
+	// base can't be computed without a map loaded. if the dirty list can't grow,
+	// everyone gets rehashed instead.
+	person_t* *new_list;
+	int       new_max;
+	
+	s_need_draw_lists = true;
+	if (person->is_hash_dirty || s_need_rehash_all) return;
+	if (s_num_dirty + 1 > s_max_dirty) {
+		new_max = (s_num_dirty + 1) * 2;
+		if (!(new_list = realloc(s_dirty_persons, new_max * sizeof(person_t*)))) {
+			s_need_rehash_all = true;
+			return;
+		}
+		s_dirty_persons = new_list;
+		s_max_dirty = new_max;
+	}
+	s_dirty_persons[s_num_dirty++] = person;
+	person->is_hash_dirty = true;
+}
+
+static struct command*
+push_person_command(person_t* person)
+{
+	// the command queue is a ring buffer with a power-of-two capacity. when it fills
+	// up, the contents are unwrapped into a buffer twice the size.
+	struct command* commands;
+	int             max_commands;
+
+	int i;
+	
+	if (person->num_commands >= person->max_commands) {
+		max_commands = person->max_commands > 0 ? person->max_commands * 2 : 16;
+		if (!(commands = malloc(max_commands * sizeof(struct command))))
+			return NULL;
+		for (i = 0; i < person->num_commands; ++i)
+			commands[i] = person->commands[(person->first_command + i) & (person->max_commands - 1)];
+		free(person->commands);
+		person->commands = commands;
+		person->max_commands = max_commands;
+		person->first_command = 0;
+	}
+	++person->num_commands;
+	return &person->commands[(person->first_command + person->num_commands - 1) & (person->max_commands - 1)];
+}
+
+static void
+rehash_person(person_t* person)
+{
+	rect_t base;
+	int    cell_x, cell_y;
+	int    key;
+	
+	unhash_person(person);
+	base = get_person_base(person);
+	if (base.x2 - base.x1 > s_hash_max_w) s_hash_max_w = base.x2 - base.x1;
+	if (base.y2 - base.y1 > s_hash_max_h) s_hash_max_h = base.y2 - base.y1;
+	cell_x = floor((base.x1 + base.x2) / 2.0 / PERSON_CELL_SIZE);
+	cell_y = floor((base.y1 + base.y2) / 2.0 / PERSON_CELL_SIZE);
+	key = hash_person_cell(person->layer, cell_x, cell_y);
+	person->hash_next = s_hash_buckets[key];
+	if (s_hash_buckets[key] != NULL)
+		s_hash_buckets[key]->hash_prev = person;
+	s_hash_buckets[key] = person;
+	person->hash_key = key;
+	person->is_hash_dirty = false;
+}
+
+static void
+reposition_person(person_t* person)
+{
+	// restore depth order after a person moves. the rest of the list is still
+	// sorted, so it's enough to slide the moved person into place.
+	int i;
+
+	i = person->sort_index;
+	while (i > 0 && compare_persons(&s_persons[i - 1], &person) > 0) {
+		s_persons[i] = s_persons[i - 1];
+		s_persons[i]->sort_index = i;
+		--i;
+	}
+	while (i < s_num_persons - 1 && compare_persons(&person, &s_persons[i + 1]) > 0) {
+		s_persons[i] = s_persons[i + 1];
+		s_persons[i]->sort_index = i;
+		++i;
+	}
+	if (i != person->sort_index)
+		s_need_draw_lists = true;
+	s_persons[i] = person;
+	person->sort_index = i;
+}
+
+static bool
 set_person_direction(person_t* person, const char* direction)
 {
-	person->direction = realloc(person->direction, (strlen(direction) + 1) * sizeof(char));
-	strcpy(person->direction, direction);
+	int direction_id;
+	
+	// if the name can't be interned, the person keeps facing the way they were
+	if ((direction_id = intern_pose_name(direction)) < 0)
+		return false;
+	person->direction_id = direction_id;
+	person->pose_index = find_sprite_pose(person->sprite, direction_id);
+	return true;
 }
 
 static void
@@ -734,15 +1085,14 @@ set_person_name(person_t* person, const char* name)
 static void
 command_person(person_t* person, int command)
 {
-	double    new_x, new_y;
-	person_t* person_to_touch;
+	double new_x, new_y;
 
 	new_x = person->x; new_y = person->y;
 	switch (command) {
 	case COMMAND_ANIMATE:
 		if (person->anim_frames > 0 && --person->anim_frames == 0) {
 			++person->frame;
-			person->anim_frames = get_sprite_frame_delay(person->sprite, person->direction, person->frame);
+			person->anim_frames = get_sprite_frame_delay(person->sprite, person->pose_index, person->frame);
 		}
 		break;
 	case COMMAND_FACE_NORTH:
@@ -782,27 +1132,171 @@ command_person(person_t* person, int command)
 		new_x = person->x - person->speed_x;
 		break;
 	}
-	if (new_x != person->x || new_y != person->y) {
-		// person is trying to move, make sure the path is clear of obstructions
-		if (!is_person_obstructed_at(person, new_x, new_y, &person_to_touch, NULL)) {
-			command_person(person, COMMAND_ANIMATE);
-			person->x = new_x; person->y = new_y;
-			person->revert_frames = person->revert_delay;
-			person->has_moved = true;
-			sort_persons();
-		}
-		else {
-			// if not, and we collided with a person, call that person's touch script
-			if (person_to_touch != NULL)
-				call_person_script(person_to_touch, PERSON_SCRIPT_ON_TOUCH, true);
-		}
+	if (new_x != person->x || new_y != person->y)
+		move_person(person, new_x, new_y);
+}
+
+static bool
+move_person(person_t* person, double new_x, double new_y)
+{
+	person_t* person_to_touch;
+
+	// person is trying to move, make sure the path is clear of obstructions
+	if (!is_person_obstructed_at(person, new_x, new_y, &person_to_touch, NULL)) {
+		command_person(person, COMMAND_ANIMATE);
+		person->x = new_x; person->y = new_y;
+		person->revert_frames = person->revert_delay;
+		person->has_moved = true;
+		mark_person_moved(person);
+		reposition_person(person);
+		return true;
+	}
+	else {
+		// if not, and we collided with a person, call that person's touch script
+		if (person_to_touch != NULL)
+			call_person_script(person_to_touch, PERSON_SCRIPT_ON_TOUCH, true);
+		return false;
 	}
 }
 
 static void
 sort_persons(void)
 {
+	int i;
+	
 	qsort(s_persons, s_num_persons, sizeof(person_t*), compare_persons);
+	for (i = 0; i < s_num_persons; ++i)
+		s_persons[i]->sort_index = i;
+	s_need_draw_lists = true;
+}
+
+static person_t*
+test_person_bucket(int key, const person_t* person, int layer, rect_t rect, person_t* obs_person)
+{
+	// if more than one person is in the way, the one earliest in draw order wins,
+	// same as the old linear scan
+	person_t* other;
+	
+	for (other = s_hash_buckets[key]; other != NULL; other = other->hash_next) {
+		if (other == person || other->layer != layer)
+			continue;
+		if (obs_person != NULL && other->y + other->y_offset >= obs_person->y + obs_person->y_offset)
+			continue;
+		if (!do_rects_intersect(rect, get_person_base(other)))
+			continue;
+		if (!is_person_ignored(person, other))
+			obs_person = other;
+	}
+	return obs_person;
+}
+
+static void
+unhash_person(person_t* person)
+{
+	if (person->hash_key < 0) return;
+	if (person->hash_prev != NULL)
+		person->hash_prev->hash_next = person->hash_next;
+	else
+		s_hash_buckets[person->hash_key] = person->hash_next;
+	if (person->hash_next != NULL)
+		person->hash_next->hash_prev = person->hash_prev;
+	person->hash_prev = person->hash_next = NULL;
+	person->hash_key = -1;
+}
+
+static void
+unindex_person_name(person_t* person)
+{
+	person_t* *p_link;
+
+	if (s_name_slots == 0) return;
+	p_link = &s_name_index[hash_person_name(person->name) & (s_name_slots - 1)];
+	while (*p_link != NULL && *p_link != person)
+		p_link = &(*p_link)->name_next;
+	if (*p_link != NULL)
+		*p_link = person->name_next;
+}
+
+static bool
+update_draw_lists(void)
+{
+	// bucket persons by layer with a counting sort. it's stable, so each layer's
+	// list stays in depth order. if either buffer can't grow, the lists are left
+	// marked stale and false is returned.
+	int       layer;
+	person_t* *new_list;
+	int*      new_starts;
+	int       num_layers;
+	
+	int i;
+
+	num_layers = 0;
+	for (i = 0; i < s_num_persons; ++i) {
+		if (s_persons[i]->layer >= num_layers)
+			num_layers = s_persons[i]->layer + 1;
+	}
+	if (!(new_starts = realloc(s_draw_starts, (num_layers + 1) * sizeof(int))))
+		return false;
+	s_draw_starts = new_starts;
+	if (!(new_list = realloc(s_draw_list, (s_max_persons > 0 ? s_max_persons : 1) * sizeof(person_t*))))
+		return false;
+	s_draw_list = new_list;
+	s_num_draw_layers = num_layers;
+	memset(s_draw_starts, 0, (s_num_draw_layers + 1) * sizeof(int));
+	for (i = 0; i < s_num_persons; ++i)
+		++s_draw_starts[s_persons[i]->layer];
+	for (layer = 1; layer <= s_num_draw_layers; ++layer)
+		s_draw_starts[layer] += s_draw_starts[layer - 1];
+	for (i = s_num_persons - 1; i >= 0; --i) {
+		layer = s_persons[i]->layer;
+		s_draw_list[--s_draw_starts[layer]] = s_persons[i];
+	}
+	s_need_draw_lists = false;
+	return true;
+}
+
+static void
+update_person_hash(void)
+{
+	int i;
+
+	if (s_need_rehash_all) {
+		for (i = 0; i < s_num_persons; ++i)
+			rehash_person(s_persons[i]);
+		s_need_rehash_all = false;
+	}
+	else {
+		for (i = 0; i < s_num_dirty; ++i)
+			rehash_person(s_dirty_persons[i]);
+	}
+	s_num_dirty = 0;
+}
+
+static bool
+walk_person(person_t* person, double x, double y)
+{
+	// advances a COMMAND_MOVE_TO by one frame. returns true when the command is
+	// done, either because the person arrived or because the way is blocked.
+	// the person walks along x first and then along y, which is the route the
+	// pathfinder checks between two waypoints.
+	
+	double new_x, new_y;
+
+	new_x = person->x;
+	new_y = person->y;
+	if (x != person->x)
+		new_x = x > person->x ? fmin(person->x + person->speed_x, x) : fmax(person->x - person->speed_x, x);
+	else
+		new_y = y > person->y ? fmin(person->y + person->speed_y, y) : fmax(person->y - person->speed_y, y);
+	if (new_x == person->x && new_y == person->y)
+		return true;  // arrived, or speed is zero and the person can't get any closer
+	if (new_x != person->x)
+		set_person_direction(person, new_x > person->x ? "east" : "west");
+	else
+		set_person_direction(person, new_y > person->y ? "south" : "north");
+	if (!move_person(person, new_x, new_y))
+		return true;
+	return new_x == x && new_y == y;
 }
 
 static duk_ret_t
@@ -1007,7 +1501,8 @@ js_GetPersonData(duk_context* ctx)
 	spriteset = person->sprite;
 	get_sprite_size(spriteset, &width, &height);
 	get_spriteset_info(spriteset, NULL, &num_directions);
-	get_spriteset_pose_info(spriteset, person->direction, &num_frames);
+	if (!get_spriteset_pose_info(spriteset, get_pose_name(person->direction_id), &num_frames))
+		num_frames = 0;
 	duk_push_global_stash(ctx);
 	duk_get_prop_string(ctx, -1, "person_data");
 	duk_get_prop_string(ctx, -1, name);
@@ -1029,7 +1524,7 @@ js_GetPersonDirection(duk_context* ctx)
 
 	if ((person = find_person(name)) == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_REFERENCE_ERROR, "GetPersonDirection(): Person '%s' doesn't exist", name);
-	duk_push_string(ctx, person->direction);
+	duk_push_string(ctx, get_pose_name(person->direction_id));
 	return 1;
 }
 
@@ -1190,6 +1685,51 @@ js_GetPersonSpeedY(duk_context* ctx)
 	return 1;
 }
 
+static duk_ret_t
+js_GetPersonStates(duk_context* ctx)
+{
+	// fills out_array with 5 numbers per person: x, y, layer, pose ID and visibility.
+	// without a name list, all persons are written in GetPersonList() order.
+	
+	int n_args = duk_get_top(ctx);
+	bool has_names = n_args >= 2;
+
+	int         count;
+	const char* name;
+	person_t*   person;
+	int         slot;
+
+	int i;
+
+	duk_require_object_coercible(ctx, 0);
+	if (!duk_is_array(ctx, 0))
+		duk_error_ni(ctx, -1, DUK_ERR_RANGE_ERROR, "GetPersonStates(): out_array argument must be an array");
+	if (has_names && !duk_is_array(ctx, 1))
+		duk_error_ni(ctx, -1, DUK_ERR_RANGE_ERROR, "GetPersonStates(): names argument must be an array");
+	count = has_names ? duk_get_length(ctx, 1) : s_num_persons;
+	for (i = 0; i < count; ++i) {
+		if (has_names) {
+			duk_get_prop_index(ctx, 1, i);
+			name = duk_require_string(ctx, -1);
+			if ((person = find_person(name)) == NULL)
+				duk_error_ni(ctx, -1, DUK_ERR_REFERENCE_ERROR, "GetPersonStates(): Person '%s' doesn't exist", name);
+			duk_pop(ctx);
+		}
+		else
+			person = s_persons[i];
+		slot = i * 5;
+		duk_push_number(ctx, person->x); duk_put_prop_index(ctx, 0, slot);
+		duk_push_number(ctx, person->y); duk_put_prop_index(ctx, 0, slot + 1);
+		duk_push_int(ctx, person->layer); duk_put_prop_index(ctx, 0, slot + 2);
+		duk_push_int(ctx, person->direction_id); duk_put_prop_index(ctx, 0, slot + 3);
+		duk_push_int(ctx, person->is_visible); duk_put_prop_index(ctx, 0, slot + 4);
+	}
+	duk_push_int(ctx, count * 5);
+	duk_put_prop_string(ctx, 0, "length");
+	duk_push_int(ctx, count);
+	return 1;
+}
+
 static duk_ret_t
 js_GetPersonValue(duk_context* ctx)
 {
@@ -1260,6 +1800,19 @@ js_GetPersonYFloat(duk_context* ctx)
 	return 1;
 }
 
+static duk_ret_t
+js_GetPoseID(duk_context* ctx)
+{
+	const char* name = duk_require_string(ctx, 0);
+	
+	int pose_id;
+
+	if ((pose_id = intern_pose_name(name)) < 0)
+		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "GetPoseID(): Failed to intern pose name '%s' (internal error)", name);
+	duk_push_int(ctx, pose_id);
+	return 1;
+}
+
 static duk_ret_t
 js_GetTalkDistance(duk_context* ctx)
 {
@@ -1321,7 +1874,8 @@ js_SetPersonDirection(duk_context* ctx)
 
 	if ((person = find_person(name)) == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_REFERENCE_ERROR, "SetPersonDirection(): Person '%s' doesn't exist", name);
-	set_person_direction(person, new_dir);
+	if (!set_person_direction(person, new_dir))
+		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "SetPersonDirection(): Failed to set direction '%s' (internal error)", new_dir);
 	return 0;
 }
 
@@ -1397,6 +1951,7 @@ js_SetPersonLayer(duk_context* ctx)
 	if ((person = find_person(name)) == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_REFERENCE_ERROR, "SetPersonLayer(): Person '%s' doesn't exist", name);
 	person->layer = layer;
+	mark_person_moved(person);
 	return 0;
 }
 
@@ -1439,6 +1994,7 @@ js_SetPersonOffsetY(duk_context* ctx)
 	if ((person = find_person(name)) == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_REFERENCE_ERROR, "SetPersonOffsetY(): Person '%s' doesn't exist", name);
 	person->y_offset = offset;
+	reposition_person(person);
 	return 0;
 }
 
@@ -1587,6 +2143,8 @@ js_SetPersonX(duk_context* ctx)
 	if ((person = find_person(name)) == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_REFERENCE_ERROR, "SetPersonX(): Person '%s' doesn't exist", name);
 	person->x = x;
+	mark_person_moved(person);
+	reposition_person(person);
 	return 0;
 }
 
@@ -1602,6 +2160,8 @@ js_SetPersonXYFloat(duk_context* ctx)
 	if ((person = find_person(name)) == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_REFERENCE_ERROR, "SetPersonXYFloat(): Person '%s' doesn't exist", name);
 	person->x = x; person->y = y;
+	mark_person_moved(person);
+	reposition_person(person);
 	return 0;
 }
 
@@ -1616,6 +2176,8 @@ js_SetPersonY(duk_context* ctx)
 	if ((person = find_person(name)) == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_REFERENCE_ERROR, "SetPersonY(): Person '%s' doesn't exist", name);
 	person->y = y;
+	mark_person_moved(person);
+	reposition_person(person);
 	return 0;
 }
 
@@ -1725,6 +2287,23 @@ js_QueuePersonCommand(duk_context* ctx)
 	return 0;
 }
 
+static duk_ret_t
+js_QueuePersonMove(duk_context* ctx)
+{
+	const char* name = duk_require_string(ctx, 0);
+	double x = duk_require_number(ctx, 1);
+	double y = duk_require_number(ctx, 2);
+	bool is_immediate = duk_require_boolean(ctx, 3);
+
+	person_t* person;
+
+	if (!(person = find_person(name)))
+		duk_error_ni(ctx, -1, DUK_ERR_REFERENCE_ERROR, "QueuePersonMove(): Person '%s' doesn't exist", name);
+	if (!queue_person_move(person, x, y, is_immediate))
+		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "QueuePersonMove(): Failed to enlarge person's command queue (internal error)");
+	return 0;
+}
+
 static duk_ret_t
 js_QueuePersonScript(duk_context* ctx)
 {
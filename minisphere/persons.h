@@ -1,3 +1,6 @@
+#ifndef MINISPHERE__PERSONS_H__INCLUDED
+#define MINISPHERE__PERSONS_H__INCLUDED
+
 #include "map_engine.h"
 #include "spriteset.h"
 
@@ -18,6 +21,7 @@ extern const char*  get_person_name            (const person_t* person);
 extern void         get_person_scale           (const person_t*, double* out_scale_x, double* out_scale_y);
 extern void         get_person_speed           (const person_t* person, double* out_x_speed, double* out_y_speed);
 extern spriteset_t* get_person_spriteset       (person_t* person);
+extern rect_t       get_person_sweep           (const person_t* person, double x1, double y1, double x2, double y2);
 extern void         get_person_xy              (const person_t* person, double* out_x, double* out_y, bool normalize);
 extern void         get_person_xyz             (const person_t* person, double* out_x, double* out_y, int* out_layer, bool want_normalize);
 extern void         set_person_angle           (person_t* person, double theta);
@@ -30,9 +34,12 @@ extern void         set_person_xyz             (person_t* person, double x, doub
 extern bool         call_person_script         (const person_t* person, int type, bool use_default);
 extern person_t*    find_person                (const char* name);
 extern bool         queue_person_command       (person_t* person, int command, bool is_immediate);
+extern bool         queue_person_move          (person_t* person, double x, double y, bool is_immediate);
 extern void         reset_persons              (bool keep_existing);
 extern void         render_persons             (int layer, bool is_flipped, int cam_x, int cam_y);
 extern void         talk_person                (const person_t* person);
+extern bool         test_person_sweep_map      (const person_t* person, rect_t sweep);
+extern bool         test_person_sweep_persons  (const person_t* person, rect_t sweep);
 extern void         update_persons             (void);
 
 extern void init_persons_api (void);
@@ -57,7 +64,8 @@ enum person_cmd
 	COMMAND_MOVE_SOUTHWEST,
 	COMMAND_MOVE_WEST,
 	COMMAND_MOVE_NORTHWEST,
-	COMMAND_RUN_SCRIPT
+	COMMAND_RUN_SCRIPT,
+	COMMAND_MOVE_TO
 };
 
 enum person_script_type
@@ -69,3 +77,5 @@ enum person_script_type
 	PERSON_SCRIPT_GENERATOR,
 	PERSON_SCRIPT_MAX
 };
+
+#endif // MINISPHERE__PERSONS_H__INCLUDED
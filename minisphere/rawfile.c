@@ -15,6 +15,8 @@ static duk_ret_t js_RawFile_close       (duk_context* ctx);
 static duk_ret_t js_RawFile_read        (duk_context* ctx);
 static duk_ret_t js_RawFile_write       (duk_context* ctx);
 
+static int s_rawfile_type = -1;
+
 void
 init_rawfile_api(void)
 {
@@ -22,6 +24,14 @@ init_rawfile_api(void)
 	duk_push_c_function(g_duktape, js_HashRawFile, DUK_VARARGS); duk_put_prop_string(g_duktape, -2, "HashRawFile");
 	duk_push_c_function(g_duktape, js_OpenRawFile, DUK_VARARGS); duk_put_prop_string(g_duktape, -2, "OpenRawFile");
 	duk_pop(g_duktape);
+	s_rawfile_type = register_api_type(g_duktape, "RawFile", js_RawFile_finalize);
+	register_api_method(g_duktape, s_rawfile_type, "toString", js_RawFile_toString);
+	register_api_method(g_duktape, s_rawfile_type, "getPosition", js_RawFile_getPosition);
+	register_api_method(g_duktape, s_rawfile_type, "getSize", js_RawFile_getSize);
+	register_api_method(g_duktape, s_rawfile_type, "setPosition", js_RawFile_setPosition);
+	register_api_method(g_duktape, s_rawfile_type, "close", js_RawFile_close);
+	register_api_method(g_duktape, s_rawfile_type, "read", js_RawFile_read);
+	register_api_method(g_duktape, s_rawfile_type, "write", js_RawFile_write);
 }
 
 static duk_ret_t
@@ -57,16 +67,7 @@ js_OpenRawFile(duk_context* ctx)
 	free(path);
 	if (file == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "OpenRawFile(): Failed to open file '%s' for %s", filename, writable ? "writing" : "reading");
-	duk_push_object(ctx);
-	duk_push_pointer(ctx, file); duk_put_prop_string(ctx, -2, "\xFF" "file_ptr");
-	duk_push_c_function(ctx, js_RawFile_finalize, DUK_VARARGS); duk_set_finalizer(ctx, -2);
-	duk_push_c_function(ctx, js_RawFile_toString, DUK_VARARGS); duk_put_prop_string(ctx, -2, "toString");
-	duk_push_c_function(ctx, js_RawFile_getPosition, DUK_VARARGS); duk_put_prop_string(ctx, -2, "getPosition");
-	duk_push_c_function(ctx, js_RawFile_getSize, DUK_VARARGS); duk_put_prop_string(ctx, -2, "getSize");
-	duk_push_c_function(ctx, js_RawFile_setPosition, DUK_VARARGS); duk_put_prop_string(ctx, -2, "setPosition");
-	duk_push_c_function(ctx, js_RawFile_close, DUK_VARARGS); duk_put_prop_string(ctx, -2, "close");
-	duk_push_c_function(ctx, js_RawFile_read, DUK_VARARGS); duk_put_prop_string(ctx, -2, "read");
-	duk_push_c_function(ctx, js_RawFile_write, DUK_VARARGS); duk_put_prop_string(ctx, -2, "write");
+	duk_push_sphere_obj(ctx, s_rawfile_type, file);
 	return 1;
 }
 
@@ -75,7 +76,7 @@ js_RawFile_finalize(duk_context* ctx)
 {
 	FILE* file;
 
-	duk_get_prop_string(ctx, 0, "\xFF" "file_ptr"); file = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	file = duk_require_sphere_obj(ctx, 0, s_rawfile_type);
 	if (file != NULL) fclose(file);
 	return 0;
 }
@@ -93,7 +94,7 @@ js_RawFile_getPosition(duk_context* ctx)
 	FILE* file;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "file_ptr"); file = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	file = duk_require_sphere_obj(ctx, -1, s_rawfile_type);
 	duk_pop(ctx);
 	if (file == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "RawFile:getPosition(): File has already been closed");
@@ -108,7 +109,7 @@ js_RawFile_getSize(duk_context* ctx)
 	long  file_pos;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "file_ptr"); file = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	file = duk_require_sphere_obj(ctx, -1, s_rawfile_type);
 	duk_pop(ctx);
 	if (file == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "RawFile:getPosition(): File has already been closed");
@@ -127,7 +128,7 @@ js_RawFile_setPosition(duk_context* ctx)
 	FILE* file;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "file_ptr"); file = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	file = duk_require_sphere_obj(ctx, -1, s_rawfile_type);
 	duk_pop(ctx);
 	if (file == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "RawFile:setPosition(): File has already been closed");
@@ -142,8 +143,8 @@ js_RawFile_close(duk_context* ctx)
 	FILE* file;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "file_ptr"); file = duk_get_pointer(ctx, -1); duk_pop(ctx);
-	duk_push_pointer(ctx, NULL); duk_put_prop_string(ctx, -2, "\xFF" "file_ptr");
+	file = duk_require_sphere_obj(ctx, -1, s_rawfile_type);
+	duk_set_sphere_obj(ctx, -1, s_rawfile_type, NULL);
 	duk_pop(ctx);
 	if (file == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "RawFile:close(): File has already been closed");
@@ -161,7 +162,7 @@ js_RawFile_read(duk_context* ctx)
 	void*         read_buffer;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "file_ptr"); file = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	file = duk_require_sphere_obj(ctx, -1, s_rawfile_type);
 	duk_pop(ctx);
 	if (num_bytes <= 0)
 		duk_error_ni(ctx, -1, DUK_ERR_RANGE_ERROR, "RawFile:read(): Must read at least 1 byte and less than 2GB; user requested %i bytes", num_bytes);
@@ -186,7 +187,7 @@ js_RawFile_write(duk_context* ctx)
 	size_t      write_size;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "file_ptr"); file = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	file = duk_require_sphere_obj(ctx, -1, s_rawfile_type);
 	duk_pop(ctx);
 	if (file == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "RawFile:write(): File has already been closed");
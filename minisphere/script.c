@@ -1,67 +1,209 @@
 #include "minisphere.h"
 
+#define MAX_CACHED_SCRIPTS 256
+
+struct script
+{
+	bool         is_valid;
+	bool         is_in_use;
+	void*        heapptr;
+	int          next_free;
+	unsigned int serial;
+};
+
+static int            s_free_script = -1;
+static int            s_max_scripts = 0;
+static int            s_num_scripts = 0;
+static struct script* s_scripts     = NULL;
+static unsigned int   s_next_serial = 0;
+static int            s_num_cached  = 0;
+
+static void push_compiled (const char* source, size_t length, const char* name);
+
+void
+initialize_scripts(void)
+{
+	s_free_script = -1;
+	s_num_scripts = s_max_scripts = 0;
+	s_scripts = NULL;
+	s_next_serial = 0;
+	s_num_cached = 0;
+}
+
+void
+shutdown_scripts(void)
+{
+	// called once the Duktape heap is gone, which takes every compiled function and
+	// the cache with it. whatever IDs are still held anywhere are dead from here on.
+	free(s_scripts);
+	s_scripts = NULL;
+	s_free_script = -1;
+	s_num_scripts = s_max_scripts = 0;
+	s_num_cached = 0;
+}
+
 int
 compile_script(const lstring_t* script, const char* name)
 {
-	int index;
+	// script slots are recycled through a free list. the compiled function lives in the
+	// stash "scripts" array at the same index, which keeps it reachable so that its heap
+	// pointer can be cached and pushed directly when the script is run.
 
+	void*          heapptr;
+	int            index;
+	struct script* new_scripts;
+	int            new_max;
+
+	if (s_free_script < 0 && s_num_scripts + 1 > s_max_scripts) {
+		new_max = (s_num_scripts + 1) * 2;
+		if (!(new_scripts = realloc(s_scripts, new_max * sizeof(struct script))))
+			return 0;
+		s_scripts = new_scripts;
+		s_max_scripts = new_max;
+	}
+	index = s_free_script >= 0 ? s_free_script : s_num_scripts;
 	duk_push_global_stash(g_duktape);
 	if (!duk_get_prop_string(g_duktape, -1, "scripts")) {
 		duk_pop(g_duktape);
 		duk_push_array(g_duktape); duk_put_prop_string(g_duktape, -2, "scripts");
 		duk_get_prop_string(g_duktape, -1, "scripts");
 	}
-	duk_get_prop_string(g_duktape, -1, "length"); index = duk_get_int(g_duktape, -1); duk_pop(g_duktape);
-	duk_push_string(g_duktape, name);
-	duk_compile_lstring_filename(g_duktape, 0x0, script->cstr, script->length);
+	push_compiled(script->cstr, script->length, name);
+	heapptr = duk_get_heapptr(g_duktape, -1);
 	duk_put_prop_index(g_duktape, -2, index);
 	duk_pop_2(g_duktape);
+
+	// compiled without error, claim the slot
+	if (index == s_free_script)
+		s_free_script = s_scripts[index].next_free;
+	else
+		++s_num_scripts;
+	s_scripts[index].is_valid = true;
+	s_scripts[index].is_in_use = false;
+	s_scripts[index].heapptr = heapptr;
+	s_scripts[index].next_free = -1;
+	s_scripts[index].serial = s_next_serial++;
 	return index + 1;
 }
 
+bool
+evaluate_script(const char* path)
+{
+	FILE*       file = NULL;
+	long        size;
+	char*       source = NULL;
+	const char* text;
+	size_t      text_len;
+
+	if (!(file = fopen(path, "rb"))) goto on_error;
+	if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0)
+		goto on_error;
+	fseek(file, 0, SEEK_SET);
+	if (!(source = malloc(size > 0 ? size : 1))) goto on_error;
+	if (fread(source, 1, size, file) != (size_t)size) goto on_error;
+	fclose(file);
+
+	// the source is moved onto the value stack first so that nothing leaks if
+	// compilation throws
+	duk_push_lstring(g_duktape, source, size);
+	free(source);
+	text = duk_get_lstring(g_duktape, -1, &text_len);
+	push_compiled(text, text_len, path);
+	duk_remove(g_duktape, -2);
+	duk_call(g_duktape, 0);
+	duk_pop(g_duktape);
+	return true;
+
+on_error:
+	if (file != NULL) fclose(file);
+	free(source);
+	return false;
+}
+
 void
 free_script(int script_id)
 {
-	if (script_id == 0)
+	int index;
+
+	index = script_id - 1;
+	if (index < 0 || index >= s_num_scripts || !s_scripts[index].is_valid)
 		return;
 	duk_push_global_stash(g_duktape);
-	if (!duk_get_prop_string(g_duktape, -1, "scripts")) {
-		duk_pop(g_duktape);
-		duk_push_array(g_duktape);
+	if (duk_get_prop_string(g_duktape, -1, "scripts")) {
+		duk_push_null(g_duktape);
+		duk_put_prop_index(g_duktape, -2, index);
 	}
-	duk_push_null(g_duktape);
-	duk_put_prop_index(g_duktape, -2, script_id - 1);
 	duk_pop_2(g_duktape);
+	s_scripts[index].is_valid = false;
+	s_scripts[index].heapptr = NULL;
+	s_scripts[index].next_free = s_free_script;
+	s_free_script = index;
 }
 
 void
 run_script(int script_id, bool allow_reentry)
 {
-	bool is_in_use;
+	int          index;
+	bool         is_in_use;
+	unsigned int serial;
 
-	if (script_id == 0)  // script 0 is guaranteed to be a no-op
+	index = script_id - 1;
+	if (index < 0 || index >= s_num_scripts || !s_scripts[index].is_valid)
+		return;  // script 0 is guaranteed to be a no-op
+	is_in_use = s_scripts[index].is_in_use;
+	if (is_in_use && !allow_reentry)
 		return;
+	duk_push_heapptr(g_duktape, s_scripts[index].heapptr);
+
+	// the script may free itself while it runs, and its slot may even be reused. the
+	// serial number tells whether the flag still belongs to this script afterwards.
+	serial = s_scripts[index].serial;
+	s_scripts[index].is_in_use = true;
+	if (duk_pcall(g_duktape, 0) != DUK_EXEC_SUCCESS) {
+		if (s_scripts[index].is_valid && s_scripts[index].serial == serial)
+			s_scripts[index].is_in_use = is_in_use;
+		duk_throw(g_duktape);
+	}
+	if (s_scripts[index].is_valid && s_scripts[index].serial == serial)
+		s_scripts[index].is_in_use = is_in_use;
+	duk_pop(g_duktape);
+}
+
+static void
+push_compiled(const char* source, size_t length, const char* name)
+{
+	// compiled functions are cached by source text and then by name, so that scripts
+	// which come back unchanged (map scripts on every map change, repeated
+	// EvaluateScript() calls) skip the compiler. the source itself is the key, so a
+	// hit is always an exact match. Duktape 1.1 can't serialize bytecode, so the
+	// cache only lives as long as the heap does.
+	
 	duk_push_global_stash(g_duktape);
-	if (!duk_get_prop_string(g_duktape, -1, "scripts")) {
+	if (!duk_get_prop_string(g_duktape, -1, "script_cache") || s_num_cached >= MAX_CACHED_SCRIPTS) {
+		// start over rather than grow without bound, e.g. when scripts are generated
+		// on the fly
+		duk_pop(g_duktape);
+		duk_push_object(g_duktape); duk_put_prop_string(g_duktape, -2, "script_cache");
+		duk_get_prop_string(g_duktape, -1, "script_cache");
+		s_num_cached = 0;
+	}
+	duk_push_lstring(g_duktape, source, length);
+	duk_dup(g_duktape, -1);
+	if (!duk_get_prop(g_duktape, -3)) {
 		duk_pop(g_duktape);
-		duk_push_array(g_duktape);
+		duk_push_object(g_duktape);
+		duk_dup(g_duktape, -2);
+		duk_dup(g_duktape, -2);
+		duk_put_prop(g_duktape, -5);
 	}
-	duk_get_prop_index(g_duktape, -1, script_id - 1);
-	if (duk_is_callable(g_duktape, -1)) {
-		duk_get_prop_string(g_duktape, -1, "isInUse");
-		is_in_use = duk_to_boolean(g_duktape, -1);
+	if (!duk_get_prop_string(g_duktape, -1, name)) {
 		duk_pop(g_duktape);
-		if (!is_in_use || allow_reentry) {
-			duk_push_true(g_duktape);
-			duk_put_prop_string(g_duktape, -2, "isInUse");
-			duk_call(g_duktape, 0);
-			duk_get_prop_index(g_duktape, -2, script_id - 1);
-			if (!duk_is_null(g_duktape, -1)) {
-				duk_push_boolean(g_duktape, is_in_use);
-				duk_put_prop_string(g_duktape, -2, "isInUse");
-			}
-			duk_pop(g_duktape);
-		}
+		duk_push_string(g_duktape, name);
+		duk_compile_lstring_filename(g_duktape, 0x0, source, length);
+		duk_dup(g_duktape, -1);
+		duk_put_prop_string(g_duktape, -3, name);
+		++s_num_cached;
 	}
-	duk_pop_3(g_duktape);
+	duk_insert(g_duktape, -5);
+	duk_pop_n(g_duktape, 4);
 }
@@ -1,8 +1,11 @@
 #ifndef MINISPHERE__SCRIPT_H__INCLUDED
 #define MINISPHERE__SCRIPT_H__INCLUDED
 
-extern int  compile_script (const lstring_t* script, const char* name);
-extern void free_script    (int script_id);
-extern void run_script     (int script_id, bool allow_reentry);
+extern void initialize_scripts (void);
+extern void shutdown_scripts   (void);
+extern int  compile_script     (const lstring_t* script, const char* name);
+extern bool evaluate_script    (const char* path);
+extern void free_script        (int script_id);
+extern void run_script         (int script_id, bool allow_reentry);
 
 #endif // MINISPHERE__SCRIPT_H__INCLUDED
@@ -36,6 +36,8 @@ struct socket
 	dyad_Stream* *backlog;
 };
 
+static int s_socket_type = -1;
+
 socket_t*
 connect_to_host(const char* hostname, int port, size_t buffer_size)
 {
@@ -234,26 +236,24 @@ init_sockets_api(void)
 	register_api_func(g_duktape, NULL, "GetLocalName", js_GetLocalName);
 	register_api_func(g_duktape, NULL, "ListenOnPort", js_ListenOnPort);
 	register_api_func(g_duktape, NULL, "OpenAddress", js_OpenAddress);
+	s_socket_type = register_api_type(g_duktape, "Socket", js_Socket_finalize);
+	register_api_method(g_duktape, s_socket_type, "toString", js_Socket_toString);
+	register_api_method(g_duktape, s_socket_type, "acceptNext", js_Socket_acceptNext);
+	register_api_method(g_duktape, s_socket_type, "isConnected", js_Socket_isConnected);
+	register_api_method(g_duktape, s_socket_type, "getPendingReadSize", js_Socket_getPendingReadSize);
+	register_api_method(g_duktape, s_socket_type, "getRemoteAddress", js_Socket_getRemoteAddress);
+	register_api_method(g_duktape, s_socket_type, "getRemotePort", js_Socket_getRemotePort);
+	register_api_method(g_duktape, s_socket_type, "close", js_Socket_close);
+	register_api_method(g_duktape, s_socket_type, "read", js_Socket_read);
+	register_api_method(g_duktape, s_socket_type, "readString", js_Socket_readString);
+	register_api_method(g_duktape, s_socket_type, "write", js_Socket_write);
 }
 
 void
 duk_push_sphere_socket(duk_context* ctx, socket_t* socket)
 {
 	ref_socket(socket);
-	duk_push_object(ctx);
-	duk_push_string(ctx, "socket"); duk_put_prop_string(ctx, -2, "\xFF" "sphere_type");
-	duk_push_pointer(ctx, socket); duk_put_prop_string(ctx, -2, "\xFF" "ptr");
-	duk_push_c_function(ctx, js_Socket_finalize, DUK_VARARGS); duk_set_finalizer(ctx, -2);
-	duk_push_c_function(ctx, js_Socket_toString, DUK_VARARGS); duk_put_prop_string(ctx, -2, "toString");
-	duk_push_c_function(ctx, js_Socket_acceptNext, DUK_VARARGS); duk_put_prop_string(ctx, -2, "acceptNext");
-	duk_push_c_function(ctx, js_Socket_isConnected, DUK_VARARGS); duk_put_prop_string(ctx, -2, "isConnected");
-	duk_push_c_function(ctx, js_Socket_getPendingReadSize, DUK_VARARGS); duk_put_prop_string(ctx, -2, "getPendingReadSize");
-	duk_push_c_function(ctx, js_Socket_getRemoteAddress, DUK_VARARGS); duk_put_prop_string(ctx, -2, "getRemoteAddress");
-	duk_push_c_function(ctx, js_Socket_getRemotePort, DUK_VARARGS); duk_put_prop_string(ctx, -2, "getRemotePort");
-	duk_push_c_function(ctx, js_Socket_close, DUK_VARARGS); duk_put_prop_string(ctx, -2, "close");
-	duk_push_c_function(ctx, js_Socket_read, DUK_VARARGS); duk_put_prop_string(ctx, -2, "read");
-	duk_push_c_function(ctx, js_Socket_readString, DUK_VARARGS); duk_put_prop_string(ctx, -2, "readString");
-	duk_push_c_function(ctx, js_Socket_write, DUK_VARARGS); duk_put_prop_string(ctx, -2, "write");
+	duk_push_sphere_obj(ctx, s_socket_type, socket);
 }
 
 static duk_ret_t
@@ -314,7 +314,7 @@ js_Socket_finalize(duk_context* ctx)
 {
 	socket_t* socket;
 
-	duk_get_prop_string(ctx, 0, "\xFF" "ptr"); socket = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	socket = duk_require_sphere_obj(ctx, 0, s_socket_type);
 	free_socket(socket);
 	return 1;
 }
@@ -332,7 +332,7 @@ js_Socket_isConnected(duk_context* ctx)
 	socket_t* socket;
 	
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); socket = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	socket = duk_require_sphere_obj(ctx, -1, s_socket_type);
 	duk_pop(ctx);
 	if (socket != NULL) {
 		if (is_socket_server(socket) && socket->max_backlog > 0)
@@ -353,7 +353,7 @@ js_Socket_getPendingReadSize(duk_context* ctx)
 	socket_t* socket;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); socket = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	socket = duk_require_sphere_obj(ctx, -1, s_socket_type);
 	duk_pop(ctx);
 	if (socket == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "Socket:getPendingReadSize(): Socket has already been closed");
@@ -371,7 +371,7 @@ js_Socket_getRemoteAddress(duk_context* ctx)
 	socket_t* socket;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); socket = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	socket = duk_require_sphere_obj(ctx, -1, s_socket_type);
 	duk_pop(ctx);
 	if (socket == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "Socket:getRemoteAddress(): Socket has already been closed");
@@ -391,7 +391,7 @@ js_Socket_getRemotePort(duk_context* ctx)
 	socket_t* socket;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); socket = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	socket = duk_require_sphere_obj(ctx, -1, s_socket_type);
 	duk_pop(ctx);
 	if (socket == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "Socket:getRemotePort(): Socket has already been closed");
@@ -412,7 +412,7 @@ js_Socket_acceptNext(duk_context* ctx)
 	socket_t* socket;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); socket = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	socket = duk_require_sphere_obj(ctx, -1, s_socket_type);
 	duk_pop(ctx);
 	if (socket == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "Socket:acceptNext(): Socket has already been closed");
@@ -435,8 +435,8 @@ js_Socket_close(duk_context* ctx)
 	socket_t* socket;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); socket = duk_get_pointer(ctx, -1); duk_pop(ctx);
-	duk_push_null(ctx); duk_put_prop_string(ctx, -2, "\xFF" "ptr");
+	socket = duk_require_sphere_obj(ctx, -1, s_socket_type);
+	duk_set_sphere_obj(ctx, -1, s_socket_type, NULL);
 	duk_pop(ctx);
 	if (socket == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "Socket:close(): Socket has already been closed");
@@ -454,7 +454,7 @@ js_Socket_read(duk_context* ctx)
 	socket_t*    socket;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); socket = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	socket = duk_require_sphere_obj(ctx, -1, s_socket_type);
 	duk_pop(ctx);
 	if (socket == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "Socket:read(): Socket has already been closed");
@@ -482,7 +482,7 @@ js_Socket_readString(duk_context* ctx)
 	socket_t* socket;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); socket = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	socket = duk_require_sphere_obj(ctx, -1, s_socket_type);
 	duk_pop(ctx);
 	if (socket == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "Socket:readString(): Socket has already been closed");
@@ -509,7 +509,7 @@ js_Socket_write(duk_context* ctx)
 	size_t         write_size;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); socket = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	socket = duk_require_sphere_obj(ctx, -1, s_socket_type);
 	duk_pop(ctx);
 	if (duk_is_string(ctx, 0))
 		payload = (uint8_t*)duk_get_lstring(ctx, 0, &write_size);
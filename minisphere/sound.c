@@ -25,36 +25,37 @@ static duk_ret_t js_Sound_stop        (duk_context* ctx);
 
 static void duk_push_sphere_sound (duk_context* ctx, ALLEGRO_AUDIO_STREAM* stream);
 
+static int s_sound_type = -1;
+
 void
 init_sound_api()
 {
 	register_api_func(g_duktape, NULL, "LoadSound", js_LoadSound);
+	s_sound_type = register_api_type(g_duktape, "Sound", js_Sound_finalize);
+	register_api_method(g_duktape, s_sound_type, "toString", js_Sound_toString);
+	register_api_method(g_duktape, s_sound_type, "isPlaying", js_Sound_isPlaying);
+	register_api_method(g_duktape, s_sound_type, "isSeekable", js_Sound_isSeekable);
+	register_api_method(g_duktape, s_sound_type, "getLength", js_Sound_getLength);
+	register_api_method(g_duktape, s_sound_type, "getPan", js_Sound_getPan);
+	register_api_method(g_duktape, s_sound_type, "getPitch", js_Sound_getPitch);
+	register_api_method(g_duktape, s_sound_type, "getPosition", js_Sound_getPosition);
+	register_api_method(g_duktape, s_sound_type, "getRepeat", js_Sound_getRepeat);
+	register_api_method(g_duktape, s_sound_type, "getVolume", js_Sound_getVolume);
+	register_api_method(g_duktape, s_sound_type, "setPan", js_Sound_setPan);
+	register_api_method(g_duktape, s_sound_type, "setPitch", js_Sound_setPitch);
+	register_api_method(g_duktape, s_sound_type, "setPosition", js_Sound_setPosition);
+	register_api_method(g_duktape, s_sound_type, "setRepeat", js_Sound_setRepeat);
+	register_api_method(g_duktape, s_sound_type, "setVolume", js_Sound_setVolume);
+	register_api_method(g_duktape, s_sound_type, "pause", js_Sound_pause);
+	register_api_method(g_duktape, s_sound_type, "play", js_Sound_play);
+	register_api_method(g_duktape, s_sound_type, "reset", js_Sound_reset);
+	register_api_method(g_duktape, s_sound_type, "stop", js_Sound_stop);
 }
 
 static void
 duk_push_sphere_sound(duk_context* ctx, ALLEGRO_AUDIO_STREAM* stream)
 {
-	duk_push_object(ctx);
-	duk_push_pointer(ctx, stream); duk_put_prop_string(ctx, -2, "\xFF" "stream_ptr");
-	duk_push_c_function(ctx, js_Sound_finalize, DUK_VARARGS); duk_set_finalizer(ctx, -2);
-	duk_push_c_function(ctx, js_Sound_toString, DUK_VARARGS); duk_put_prop_string(ctx, -2, "toString");
-	duk_push_c_function(ctx, js_Sound_isPlaying, DUK_VARARGS); duk_put_prop_string(ctx, -2, "isPlaying");
-	duk_push_c_function(ctx, js_Sound_isSeekable, DUK_VARARGS); duk_put_prop_string(ctx, -2, "isSeekable");
-	duk_push_c_function(ctx, js_Sound_getLength, DUK_VARARGS); duk_put_prop_string(ctx, -2, "getLength");
-	duk_push_c_function(ctx, js_Sound_getPan, DUK_VARARGS); duk_put_prop_string(ctx, -2, "getPan");
-	duk_push_c_function(ctx, js_Sound_getPitch, DUK_VARARGS); duk_put_prop_string(ctx, -2, "getPitch");
-	duk_push_c_function(ctx, js_Sound_getPosition, DUK_VARARGS); duk_put_prop_string(ctx, -2, "getPosition");
-	duk_push_c_function(ctx, js_Sound_getRepeat, DUK_VARARGS); duk_put_prop_string(ctx, -2, "getRepeat");
-	duk_push_c_function(ctx, js_Sound_getVolume, DUK_VARARGS); duk_put_prop_string(ctx, -2, "getVolume");
-	duk_push_c_function(ctx, js_Sound_setPan, DUK_VARARGS); duk_put_prop_string(ctx, -2, "setPan");
-	duk_push_c_function(ctx, js_Sound_setPitch, DUK_VARARGS); duk_put_prop_string(ctx, -2, "setPitch");
-	duk_push_c_function(ctx, js_Sound_setPosition, DUK_VARARGS); duk_put_prop_string(ctx, -2, "setPosition");
-	duk_push_c_function(ctx, js_Sound_setRepeat, DUK_VARARGS); duk_put_prop_string(ctx, -2, "setRepeat");
-	duk_push_c_function(ctx, js_Sound_setVolume, DUK_VARARGS); duk_put_prop_string(ctx, -2, "setVolume");
-	duk_push_c_function(ctx, js_Sound_pause, DUK_VARARGS); duk_put_prop_string(ctx, -2, "pause");
-	duk_push_c_function(ctx, js_Sound_play, DUK_VARARGS); duk_put_prop_string(ctx, -2, "play");
-	duk_push_c_function(ctx, js_Sound_reset, DUK_VARARGS); duk_put_prop_string(ctx, -2, "reset");
-	duk_push_c_function(ctx, js_Sound_stop, DUK_VARARGS); duk_put_prop_string(ctx, -2, "stop");
+	duk_push_sphere_obj(ctx, s_sound_type, stream);
 }
 
 static duk_ret_t
@@ -80,7 +81,7 @@ static duk_ret_t
 js_Sound_finalize(duk_context* ctx)
 {
 	ALLEGRO_AUDIO_STREAM* stream;
-	duk_get_prop_string(ctx, 0, "\xFF" "stream_ptr"); stream = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	stream = duk_require_sphere_obj(ctx, 0, s_sound_type);
 	al_set_audio_stream_playing(stream, false);
 	al_detach_audio_stream(stream);
 	al_destroy_audio_stream(stream);
@@ -100,7 +101,7 @@ js_Sound_isPlaying(duk_context* ctx)
 	ALLEGRO_AUDIO_STREAM* stream;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "stream_ptr"); stream = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	stream = duk_require_sphere_obj(ctx, -1, s_sound_type);
 	duk_pop(ctx);
 	duk_push_boolean(ctx, al_get_audio_stream_playing(stream));
 	return 1;
@@ -119,7 +120,7 @@ js_Sound_getLength(duk_context* ctx)
 	ALLEGRO_AUDIO_STREAM* stream;
 	
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "stream_ptr"); stream = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	stream = duk_require_sphere_obj(ctx, -1, s_sound_type);
 	duk_pop(ctx);
 	duk_push_int(ctx, al_get_audio_stream_length_secs(stream) * 1000);
 	return 1;
@@ -131,7 +132,7 @@ js_Sound_getPan(duk_context* ctx)
 	ALLEGRO_AUDIO_STREAM* stream;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "stream_ptr"); stream = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	stream = duk_require_sphere_obj(ctx, -1, s_sound_type);
 	duk_pop(ctx);
 	duk_push_int(ctx, al_get_audio_stream_pan(stream) * 255);
 	return 1;
@@ -143,7 +144,7 @@ js_Sound_getPitch(duk_context* ctx)
 	ALLEGRO_AUDIO_STREAM* stream;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "stream_ptr"); stream = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	stream = duk_require_sphere_obj(ctx, -1, s_sound_type);
 	duk_pop(ctx);
 	duk_push_number(ctx, al_get_audio_stream_speed(stream));
 	return 1;
@@ -155,7 +156,7 @@ js_Sound_getPosition(duk_context* ctx)
 	ALLEGRO_AUDIO_STREAM* stream;
 	
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "stream_ptr"); stream = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	stream = duk_require_sphere_obj(ctx, -1, s_sound_type);
 	duk_pop(ctx);
 	duk_push_int(ctx, al_get_audio_stream_position_secs(stream) * 1000);
 	return 1;
@@ -166,7 +167,7 @@ js_Sound_getRepeat(duk_context* ctx)
 {
 	ALLEGRO_AUDIO_STREAM* stream;
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "stream_ptr"); stream = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	stream = duk_require_sphere_obj(ctx, -1, s_sound_type);
 	duk_pop(ctx);
 	duk_push_boolean(ctx, al_get_audio_stream_playmode(stream) == ALLEGRO_PLAYMODE_LOOP);
 	return 1;
@@ -177,7 +178,7 @@ js_Sound_getVolume(duk_context* ctx)
 {
 	ALLEGRO_AUDIO_STREAM* stream;
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "stream_ptr"); stream = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	stream = duk_require_sphere_obj(ctx, -1, s_sound_type);
 	duk_pop(ctx);
 	duk_push_int(ctx, (int)(255 * al_get_audio_stream_gain(stream)));
 	return 1;
@@ -190,7 +191,7 @@ js_Sound_setPan(duk_context* ctx)
 	ALLEGRO_AUDIO_STREAM* stream;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "stream_ptr"); stream = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	stream = duk_require_sphere_obj(ctx, -1, s_sound_type);
 	duk_pop(ctx);
 	new_pan = duk_to_int(ctx, 0);
 	al_set_audio_stream_pan(stream, (float)new_pan / 255);
@@ -204,7 +205,7 @@ js_Sound_setPitch(duk_context* ctx)
 	ALLEGRO_AUDIO_STREAM* stream;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "stream_ptr"); stream = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	stream = duk_require_sphere_obj(ctx, -1, s_sound_type);
 	duk_pop(ctx);
 	new_pitch = duk_get_number(ctx, 0);
 	al_set_audio_stream_speed(stream, new_pitch);
@@ -218,7 +219,7 @@ js_Sound_setPosition(duk_context* ctx)
 	ALLEGRO_AUDIO_STREAM* stream;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "stream_ptr"); stream = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	stream = duk_require_sphere_obj(ctx, -1, s_sound_type);
 	duk_pop(ctx);
 	new_pos = duk_get_int(ctx, 0);
 	al_seek_audio_stream_secs(stream, (double)new_pos / 1000);
@@ -233,7 +234,7 @@ js_Sound_setRepeat(duk_context* ctx)
 	ALLEGRO_AUDIO_STREAM* stream;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "stream_ptr"); stream = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	stream = duk_require_sphere_obj(ctx, -1, s_sound_type);
 	duk_pop(ctx);
 	is_looped = duk_get_boolean(ctx, 0);
 	play_mode = is_looped ? ALLEGRO_PLAYMODE_LOOP : ALLEGRO_PLAYMODE_ONCE;
@@ -246,7 +247,7 @@ js_Sound_setVolume(duk_context* ctx)
 {
 	ALLEGRO_AUDIO_STREAM* stream;
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "stream_ptr"); stream = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	stream = duk_require_sphere_obj(ctx, -1, s_sound_type);
 	duk_pop(ctx);
 	float new_vol = duk_get_number(ctx, 0) / 255;
 	al_set_audio_stream_gain(stream, new_vol);
@@ -258,7 +259,7 @@ js_Sound_pause(duk_context* ctx)
 {
 	ALLEGRO_AUDIO_STREAM* stream;
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "stream_ptr"); stream = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	stream = duk_require_sphere_obj(ctx, -1, s_sound_type);
 	duk_pop(ctx);
 	al_set_audio_stream_playing(stream, false);
 	return 0;
@@ -272,7 +273,7 @@ js_Sound_play(duk_context* ctx)
 
 	n_args = duk_get_top(ctx);
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "stream_ptr"); stream = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	stream = duk_require_sphere_obj(ctx, -1, s_sound_type);
 	duk_pop(ctx);
 	if (n_args >= 1) {
 		ALLEGRO_PLAYMODE play_mode = duk_get_boolean(ctx, 0)
@@ -290,7 +291,7 @@ js_Sound_reset(duk_context* ctx)
 {
 	ALLEGRO_AUDIO_STREAM* stream;
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "stream_ptr"); stream = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	stream = duk_require_sphere_obj(ctx, -1, s_sound_type);
 	duk_pop(ctx);
 	al_seek_audio_stream_secs(stream, 0.0);
 	al_set_audio_stream_playing(stream, true);
@@ -302,7 +303,7 @@ js_Sound_stop(duk_context* ctx)
 {
 	ALLEGRO_AUDIO_STREAM* stream;
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "stream_ptr"); stream = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	stream = duk_require_sphere_obj(ctx, -1, s_sound_type);
 	duk_pop(ctx);
 	al_set_audio_stream_playing(stream, false);
 	al_seek_audio_stream_secs(stream, 0.0);
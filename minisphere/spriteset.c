@@ -48,6 +48,29 @@ struct rss_frame_v3
 };
 #pragma pack(pop)
 
+struct pose_name
+{
+	char*        name;
+	unsigned int hash;
+	int          key;
+	int          alt_key;
+};
+
+struct frame_atlas
+{
+	int      cell_w, cell_h;
+	int      pitch;
+	int      cells_per_page;
+	int      num_pages;
+	image_t* *pages;
+};
+
+struct shared_spriteset
+{
+	char*        path;
+	spriteset_t* spriteset;
+};
+
 static duk_ret_t js_LoadSpriteset       (duk_context* ctx);
 static duk_ret_t js_Spriteset_finalize  (duk_context* ctx);
 static duk_ret_t js_Spriteset_toString  (duk_context* ctx);
@@ -55,7 +78,43 @@ static duk_ret_t js_Spriteset_clone     (duk_context* ctx);
 static duk_ret_t js_Spriteset_get_image (duk_context* ctx);
 static duk_ret_t js_Spriteset_set_image (duk_context* ctx);
 
-static const spriteset_pose_t* find_sprite_pose (const spriteset_t* spriteset, const char* pose_name);
+static void         free_frame_atlas (struct frame_atlas* atlas);
+static unsigned int hash_pose_name   (const char* name);
+static bool         init_frame_atlas (struct frame_atlas* atlas, int num_images, int cell_w, int cell_h);
+static bool         key_sprite_poses (spriteset_t* spriteset);
+static image_t*     read_atlas_frame (struct frame_atlas* atlas, memfile_t* file, int index, int width, int height);
+
+static int                      s_max_pose_names = 0;
+static int                      s_num_pose_names = 0;
+static int                      s_num_pose_slots = 0;
+static int                      s_max_shared     = 0;
+static int                      s_num_shared     = 0;
+static struct pose_name*        s_pose_names     = NULL;
+static int*                     s_pose_slots     = NULL;
+static struct shared_spriteset* s_shared         = NULL;
+static int                      s_spriteset_type = -1;
+
+void
+shutdown_spritesets(void)
+{
+	// called after the Duktape heap is gone, so no spriteset can be released
+	// after this point
+	int i;
+	
+	for (i = 0; i < s_num_shared; ++i)
+		free(s_shared[i].path);
+	free(s_shared);
+	s_shared = NULL;
+	s_num_shared = s_max_shared = 0;
+	for (i = 0; i < s_num_pose_names; ++i)
+		free(s_pose_names[i].name);
+	free(s_pose_names);
+	free(s_pose_slots);
+	s_pose_names = NULL;
+	s_pose_slots = NULL;
+	s_num_pose_names = s_max_pose_names = 0;
+	s_num_pose_slots = 0;
+}
 
 spriteset_t*
 clone_spriteset(const spriteset_t* spriteset)
@@ -77,6 +136,7 @@ clone_spriteset(const spriteset_t* spriteset)
 	for (i = 0; i < spriteset->num_poses; ++i) {
 		if ((clone->poses[i].name = clone_lstring(spriteset->poses[i].name)) == NULL)
 			goto on_error;
+		clone->poses[i].name_key = spriteset->poses[i].name_key;
 		clone->poses[i].num_frames = spriteset->poses[i].num_frames;
 		if ((clone->poses[i].frames = calloc(clone->poses[i].num_frames, sizeof(spriteset_frame_t))) == NULL)
 			goto on_error;
@@ -110,6 +170,7 @@ load_spriteset(const char* path)
 		"south", "southwest", "west", "northwest"
 	};
 	
+	struct frame_atlas  atlas;
 	char*               base_path;
 	struct rss_dir_v2   dir_v2;
 	struct rss_dir_v3   dir_v3;
@@ -117,17 +178,19 @@ load_spriteset(const char* path)
 	ALLEGRO_PATH*       filename_path;
 	struct rss_frame_v2 frame_v2;
 	struct rss_frame_v3 frame_v3;
-	FILE*               file = NULL;
+	memfile_t*          file = NULL;
 	int                 image_index;
+	int                 max_w, max_h;
 	struct rss_header   rss;
 	long                skip_size;
 	spriteset_t*        spriteset = NULL;
 	long                v2_data_offset;
 	int                 i, j;
 
+	memset(&atlas, 0, sizeof(struct frame_atlas));
 	if ((spriteset = calloc(1, sizeof(spriteset_t))) == NULL) goto on_error;
-	if (!(file = fopen(path, "rb"))) goto on_error;
-	if (fread(&rss, sizeof(struct rss_header), 1, file) != 1)
+	if (!(file = open_memfile(path))) goto on_error;
+	if (!read_memfile(file, &rss, sizeof(struct rss_header)))
 		goto on_error;
 	if (memcmp(rss.signature, ".rss", 4) != 0) goto on_error;
 	spriteset->base.x1 = rss.base_x1;
@@ -143,8 +206,10 @@ load_spriteset(const char* path)
 			spriteset->poses[i].name = lstring_from_cstr(def_dir_names[i]);
 		if ((spriteset->images = calloc(spriteset->num_images, sizeof(image_t*))) == NULL)
 			goto on_error;
+		if (!init_frame_atlas(&atlas, spriteset->num_images, rss.frame_width, rss.frame_height))
+			goto on_error;
 		for (i = 0; i < spriteset->num_images; ++i) {
-			if ((spriteset->images[i] = read_image(file, rss.frame_width, rss.frame_height)) == NULL)
+			if ((spriteset->images[i] = read_atlas_frame(&atlas, file, i, rss.frame_width, rss.frame_height)) == NULL)
 				goto on_error;
 		}
 		for (i = 0; i < spriteset->num_poses; ++i) {
@@ -161,11 +226,12 @@ load_spriteset(const char* path)
 		if (!(spriteset->poses = calloc(spriteset->num_poses, sizeof(spriteset_pose_t))))
 			goto on_error;
 
-		// pass 1 - prepare structures, calculate number of images
-		v2_data_offset = ftell(file);
+		// pass 1 - prepare structures, calculate number of images and atlas cell size
+		v2_data_offset = tell_memfile(file);
 		spriteset->num_images = 0;
+		max_w = rss.frame_width; max_h = rss.frame_height;
 		for (i = 0; i < rss.num_directions; ++i) {
-			if (fread(&dir_v2, sizeof(struct rss_dir_v2), 1, file) != 1)
+			if (!read_memfile(file, &dir_v2, sizeof(struct rss_dir_v2)))
 				goto on_error;
 			spriteset->num_images += dir_v2.num_frames;
 			sprintf(extra_v2_dir_name, "extra %i", i);
@@ -174,27 +240,32 @@ load_spriteset(const char* path)
 			if (!(spriteset->poses[i].frames = calloc(dir_v2.num_frames, sizeof(spriteset_frame_t))))
 				goto on_error;
 			for (j = 0; j < dir_v2.num_frames; ++j) {  // skip over frame and image data
-				if (fread(&frame_v2, sizeof(struct rss_frame_v2), 1, file) != 1)
+				if (!read_memfile(file, &frame_v2, sizeof(struct rss_frame_v2)))
 					goto on_error;
 				skip_size = (rss.frame_width != 0 ? rss.frame_width : frame_v2.width)
 					* (rss.frame_height != 0 ? rss.frame_height : frame_v2.height)
 					* 4;
-				fseek(file, skip_size, SEEK_CUR);
+				if (rss.frame_width == 0 && frame_v2.width > max_w) max_w = frame_v2.width;
+				if (rss.frame_height == 0 && frame_v2.height > max_h) max_h = frame_v2.height;
+				if (!seek_memfile(file, skip_size, SEEK_CUR))
+					goto on_error;
 			}
 		}
 		if (!(spriteset->images = calloc(spriteset->num_images, sizeof(image_t*))))
 			goto on_error;
+		if (!init_frame_atlas(&atlas, spriteset->num_images, max_w, max_h))
+			goto on_error;
 
 		// pass 2 - read images and frame data
-		fseek(file, v2_data_offset, SEEK_SET);
+		seek_memfile(file, v2_data_offset, SEEK_SET);
 		image_index = 0;
 		for (i = 0; i < rss.num_directions; ++i) {
-			if (fread(&dir_v2, sizeof(struct rss_dir_v2), 1, file) != 1)
+			if (!read_memfile(file, &dir_v2, sizeof(struct rss_dir_v2)))
 				goto on_error;
 			for (j = 0; j < dir_v2.num_frames; ++j) {
-				if (fread(&frame_v2, sizeof(struct rss_frame_v2), 1, file) != 1)
+				if (!read_memfile(file, &frame_v2, sizeof(struct rss_frame_v2)))
 					goto on_error;
-				spriteset->images[image_index] = read_image(file,
+				spriteset->images[image_index] = read_atlas_frame(&atlas, file, image_index,
 					rss.frame_width != 0 ? rss.frame_width : frame_v2.width,
 					rss.frame_height != 0 ? rss.frame_height : frame_v2.height);
 				spriteset->poses[i].frames[j].image_idx = image_index;
@@ -210,19 +281,21 @@ load_spriteset(const char* path)
 			goto on_error;
 		if ((spriteset->poses = calloc(spriteset->num_poses, sizeof(spriteset_pose_t))) == NULL)
 			goto on_error;
+		if (!init_frame_atlas(&atlas, spriteset->num_images, rss.frame_width, rss.frame_height))
+			goto on_error;
 		for (i = 0; i < rss.num_images; ++i) {
-			if ((spriteset->images[i] = read_image(file, rss.frame_width, rss.frame_height)) == NULL)
+			if ((spriteset->images[i] = read_atlas_frame(&atlas, file, i, rss.frame_width, rss.frame_height)) == NULL)
 				goto on_error;
 		}
 		for (i = 0; i < rss.num_directions; ++i) {
-			if (fread(&dir_v3, sizeof(struct rss_dir_v3), 1, file) != 1)
+			if (!read_memfile(file, &dir_v3, sizeof(struct rss_dir_v3)))
 				goto on_error;
 			if ((spriteset->poses[i].name = read_lstring(file, true)) == NULL) goto on_error;
 			spriteset->poses[i].num_frames = dir_v3.num_frames;
 			if ((spriteset->poses[i].frames = calloc(dir_v3.num_frames, sizeof(spriteset_frame_t))) == NULL)
 				goto on_error;
 			for (j = 0; j < spriteset->poses[i].num_frames; ++j) {
-				if (fread(&frame_v3, sizeof(struct rss_frame_v3), 1, file) != 1)
+				if (!read_memfile(file, &frame_v3, sizeof(struct rss_frame_v3)))
 					goto on_error;
 				spriteset->poses[i].frames[j].image_idx = frame_v3.image_idx;
 				spriteset->poses[i].frames[j].delay = frame_v3.delay;
@@ -232,7 +305,10 @@ load_spriteset(const char* path)
 	default: // invalid RSS version
 		goto on_error;
 	}
-	fclose(file);
+	if (!key_sprite_poses(spriteset))
+		goto on_error;
+	close_memfile(file);
+	free_frame_atlas(&atlas);
 	
 	// get spriteset path relative to game directory
 	base_path = get_asset_path("~/", NULL, false);
@@ -245,8 +321,14 @@ load_spriteset(const char* path)
 	return ref_spriteset(spriteset);
 
 on_error:
-	if (file != NULL) fclose(file);
+	close_memfile(file);
+	free_frame_atlas(&atlas);
 	if (spriteset != NULL) {
+		if (spriteset->images != NULL) {
+			for (i = 0; i < spriteset->num_images; ++i)
+				free_image(spriteset->images[i]);
+			free(spriteset->images);
+		}
 		if (spriteset->poses != NULL) {
 			for (i = 0; i < spriteset->num_poses; ++i) {
 				free_lstring(spriteset->poses[i].name);
@@ -259,6 +341,70 @@ on_error:
 	return NULL;
 }
 
+spriteset_t*
+load_shared_spriteset(const char* path)
+{
+	// persons never hand their spriteset to script without cloning it first, so all
+	// persons using the same file can share one copy. the cache holds no reference of
+	// its own; free_spriteset() drops the entry once the last user lets go. if the
+	// cache can't grow, the spriteset is still returned, just unshared.
+	// the cache is keyed on the canonical path so that different spellings of the
+	// same file share one copy.
+	
+	ALLEGRO_PATH*            canon_path = NULL;
+	int                      new_max;
+	struct shared_spriteset* new_shared;
+	char*                    shared_path;
+	spriteset_t*             spriteset;
+	
+	int i;
+
+	if (!(canon_path = al_create_path(path)))
+		return load_spriteset(path);
+	al_make_path_canonical(canon_path);
+	for (i = 1; i < al_get_path_num_components(canon_path); ++i) {
+		// al_make_path_canonical() leaves "dir/.." pairs in place, collapse them here
+		if (strcmp(al_get_path_component(canon_path, i), "..") == 0
+			&& strcmp(al_get_path_component(canon_path, i - 1), "..") != 0
+			&& strcmp(al_get_path_component(canon_path, i - 1), "") != 0)
+		{
+			al_remove_path_component(canon_path, i);
+			al_remove_path_component(canon_path, i - 1);
+			i = 0;
+		}
+	}
+	path = al_path_cstr(canon_path, ALLEGRO_NATIVE_PATH_SEP);
+	for (i = 0; i < s_num_shared; ++i) {
+		if (strcmp(path, s_shared[i].path) == 0) {
+			al_destroy_path(canon_path);
+			return ref_spriteset(s_shared[i].spriteset);
+		}
+	}
+	if ((spriteset = load_spriteset(path)) == NULL)
+		goto on_error;
+	if (!(shared_path = strdup(path)))
+		goto on_error;
+	al_destroy_path(canon_path);
+	if (s_num_shared + 1 > s_max_shared) {
+		new_max = (s_num_shared + 1) * 2;
+		if (!(new_shared = realloc(s_shared, new_max * sizeof(struct shared_spriteset)))) {
+			free(shared_path);
+			return spriteset;
+		}
+		s_shared = new_shared;
+		s_max_shared = new_max;
+	}
+	s_shared[s_num_shared].path = shared_path;
+	s_shared[s_num_shared].spriteset = spriteset;
+	++s_num_shared;
+	spriteset->is_shared = true;
+	return spriteset;
+
+on_error:
+	al_destroy_path(canon_path);
+	return spriteset;
+}
+
 spriteset_t*
 ref_spriteset(spriteset_t* spriteset)
 {
@@ -273,6 +419,15 @@ free_spriteset(spriteset_t* spriteset)
 	
 	if (spriteset == NULL || --spriteset->refcount > 0)
 		return;
+	if (spriteset->is_shared) {
+		for (i = 0; i < s_num_shared; ++i) {
+			if (s_shared[i].spriteset == spriteset) {
+				free(s_shared[i].path);
+				s_shared[i] = s_shared[--s_num_shared];
+				break;
+			}
+		}
+	}
 	for (i = 0; i < spriteset->num_images; ++i) {
 		free_image(spriteset->images[i]);
 	}
@@ -286,6 +441,126 @@ free_spriteset(spriteset_t* spriteset)
 	free(spriteset);
 }
 
+int
+intern_pose_name(const char* name)
+{
+	// pose names are interned for the lifetime of the engine. besides its own ID, each
+	// entry records the ID of its lowercase form (the key), since poses are matched
+	// case-insensitively, and the key of the pose to fall back on if it's missing.
+	
+	int              alt_key;
+	char*            folded;
+	unsigned int     hash;
+	int              id;
+	int              key;
+	int              new_max;
+	struct pose_name *new_names;
+	char*            new_name;
+	struct pose_name *p_entry;
+	int              *slots;
+	int              num_slots;
+	
+	int i, j;
+
+	hash = hash_pose_name(name);
+	if (s_num_pose_slots > 0) {
+		i = hash & (s_num_pose_slots - 1);
+		while ((id = s_pose_slots[i]) >= 0) {
+			if (s_pose_names[id].hash == hash && strcmp(s_pose_names[id].name, name) == 0)
+				return id;
+			i = (i + 1) & (s_num_pose_slots - 1);
+		}
+	}
+
+	// first time we've seen this name, work out its key and add it.
+	// nothing is committed until every allocation has succeeded, so on failure the
+	// table is left as it was and -1 is returned.
+	if (!(folded = strdup(name))) return -1;
+	for (i = 0; folded[i] != '\0'; ++i)
+		if (folded[i] >= 'A' && folded[i] <= 'Z') folded[i] += 'a' - 'A';
+	if (strcmp(folded, name) != 0) {
+		key = intern_pose_name(folded);
+		free(folded);
+		if (key < 0) return -1;
+		alt_key = s_pose_names[key].alt_key;
+	}
+	else {
+		free(folded);
+		alt_key = -1;
+		if (strcmp(name, "northeast") == 0 || strcmp(name, "northwest") == 0) {
+			if ((alt_key = intern_pose_name("north")) < 0) return -1;
+		}
+		else if (strcmp(name, "southeast") == 0 || strcmp(name, "southwest") == 0) {
+			if ((alt_key = intern_pose_name("south")) < 0) return -1;
+		}
+		key = s_num_pose_names;
+	}
+	if (!(new_name = strdup(name))) return -1;
+	if (s_num_pose_names + 1 > s_max_pose_names) {
+		new_max = (s_num_pose_names + 1) * 2;
+		if (!(new_names = realloc(s_pose_names, new_max * sizeof(struct pose_name))))
+			goto on_error;
+		s_pose_names = new_names;
+		s_max_pose_names = new_max;
+	}
+	
+	// keep the slot table at most half full
+	if ((s_num_pose_names + 1) * 2 > s_num_pose_slots) {
+		num_slots = s_num_pose_slots > 0 ? s_num_pose_slots * 2 : 64;
+		if (!(slots = malloc(num_slots * sizeof(int))))
+			goto on_error;
+		memset(slots, 0xFF, num_slots * sizeof(int));
+		free(s_pose_slots);
+		s_pose_slots = slots;
+		s_num_pose_slots = num_slots;
+		for (j = 0; j < s_num_pose_names; ++j) {
+			i = s_pose_names[j].hash & (num_slots - 1);
+			while (s_pose_slots[i] >= 0) i = (i + 1) & (num_slots - 1);
+			s_pose_slots[i] = j;
+		}
+	}
+	id = s_num_pose_names++;
+	p_entry = &s_pose_names[id];
+	p_entry->name = new_name;
+	p_entry->hash = hash;
+	p_entry->key = key;
+	p_entry->alt_key = alt_key;
+	i = hash & (s_num_pose_slots - 1);
+	while (s_pose_slots[i] >= 0) i = (i + 1) & (s_num_pose_slots - 1);
+	s_pose_slots[i] = id;
+	return id;
+
+on_error:
+	free(new_name);
+	return -1;
+}
+
+const char*
+get_pose_name(int name_id)
+{
+	return name_id >= 0 ? s_pose_names[name_id].name : NULL;
+}
+
+int
+find_sprite_pose(const spriteset_t* spriteset, int name_id)
+{
+	int alt_key;
+	int key;
+	
+	int i;
+
+	if (name_id < 0) return 0;
+	key = s_pose_names[name_id].key;
+	alt_key = s_pose_names[name_id].alt_key;
+	for (i = 0; i < spriteset->num_poses; ++i)
+		if (spriteset->poses[i].name_key == key) return i;
+	if (alt_key >= 0) {
+		for (i = 0; i < spriteset->num_poses; ++i)
+			if (spriteset->poses[i].name_key == alt_key) return i;
+	}
+	return 0;
+}
+
 rect_t
 get_sprite_base(const spriteset_t* spriteset)
 {
@@ -293,16 +568,28 @@ get_sprite_base(const spriteset_t* spriteset)
 }
 
 int
-get_sprite_frame_delay(const spriteset_t* spriteset, const char* pose_name, int frame_index)
+get_sprite_frame_delay(const spriteset_t* spriteset, int pose_index, int frame_index)
 {
 	const spriteset_pose_t* pose;
 	
-	if ((pose = find_sprite_pose(spriteset, pose_name)) == NULL)
-		return 0;
+	pose = &spriteset->poses[pose_index];
 	frame_index %= pose->num_frames;
 	return pose->frames[frame_index].delay;
 }
 
+void
+get_sprite_frame_size(const spriteset_t* spriteset, int pose_index, int frame_index, int* out_width, int* out_height)
+{
+	image_t*                image;
+	const spriteset_pose_t* pose;
+	
+	pose = &spriteset->poses[pose_index];
+	frame_index %= pose->num_frames;
+	image = spriteset->images[pose->frames[frame_index].image_idx];
+	if (out_width) *out_width = get_image_width(image);
+	if (out_height) *out_height = get_image_height(image);
+}
+
 void
 get_sprite_size(const spriteset_t* spriteset, int* out_width, int* out_height)
 {
@@ -329,10 +616,12 @@ get_spriteset_image(const spriteset_t* spriteset, int image_index)
 bool
 get_spriteset_pose_info(const spriteset_t* spriteset, const char* pose_name, int* out_num_frames)
 {
+	int                     name_id;
 	const spriteset_pose_t* pose;
 
-	if ((pose = find_sprite_pose(spriteset, pose_name)) == NULL)
+	if ((name_id = intern_pose_name(pose_name)) < 0)
 		return false;
+	pose = &spriteset->poses[find_sprite_pose(spriteset, name_id)];
 	*out_num_frames = pose->num_frames;
 	return true;
 }
@@ -348,15 +637,14 @@ set_spriteset_image(const spriteset_t* spriteset, int image_index, image_t* imag
 }
 
 void
-draw_sprite(const spriteset_t* spriteset, color_t mask, bool is_flipped, double theta, double scale_x, double scale_y, const char* pose_name, float x, float y, int frame_index)
+draw_sprite(const spriteset_t* spriteset, color_t mask, bool is_flipped, double theta, double scale_x, double scale_y, int pose_index, float x, float y, int frame_index)
 {
 	image_t*                 image;
 	int                      image_index;
 	int                      image_w, image_h;
 	const spriteset_pose_t*  pose;
 	
-	if ((pose = find_sprite_pose(spriteset, pose_name)) == NULL)
-		return;
+	pose = &spriteset->poses[pose_index];
 	frame_index = frame_index % pose->num_frames;
 	image_index = pose->frames[frame_index].image_idx;
 	x -= (spriteset->base.x1 + spriteset->base.x2) / 2;
@@ -365,7 +653,7 @@ draw_sprite(const spriteset_t* spriteset, color_t mask, bool is_flipped, double
 	image = spriteset->images[image_index];
 	image_w = get_image_width(image);
 	image_h = get_image_height(image);
-	al_draw_tinted_scaled_rotated_bitmap(get_image_bitmap(image), al_map_rgba(mask.r, mask.g, mask.b, mask.alpha),
+	al_draw_tinted_scaled_rotated_bitmap(get_image_bitmap(image), nativecolor(mask),
 		(float)image_w / 2, (float)image_h / 2, x + (float)image_w / 2, y + (float)image_h / 2,
 		scale_x, scale_y, theta, is_flipped ? ALLEGRO_FLIP_VERTICAL : 0x0);
 }
@@ -374,6 +662,9 @@ void
 init_spriteset_api(duk_context* ctx)
 {
 	register_api_func(ctx, NULL, "LoadSpriteset", js_LoadSpriteset);
+	s_spriteset_type = register_api_type(ctx, "Spriteset", js_Spriteset_finalize);
+	register_api_method(ctx, s_spriteset_type, "toString", js_Spriteset_toString);
+	register_api_method(ctx, s_spriteset_type, "clone", js_Spriteset_clone);
 }
 
 void
@@ -385,12 +676,7 @@ duk_push_sphere_spriteset(duk_context* ctx, spriteset_t* spriteset)
 
 	ref_spriteset(spriteset);
 
-	duk_push_object(ctx);
-	duk_push_string(ctx, "spriteset"); duk_put_prop_string(ctx, -2, "\xFF" "sphere_type");
-	duk_push_pointer(ctx, spriteset); duk_put_prop_string(ctx, -2, "\xFF" "ptr");
-	duk_push_c_function(ctx, js_Spriteset_finalize, DUK_VARARGS); duk_set_finalizer(ctx, -2);
-	duk_push_c_function(ctx, js_Spriteset_toString, DUK_VARARGS); duk_put_prop_string(ctx, -2, "toString");
-	duk_push_c_function(ctx, js_Spriteset_clone, DUK_VARARGS); duk_put_prop_string(ctx, -2, "clone");
+	duk_push_sphere_obj(ctx, s_spriteset_type, spriteset);
 	duk_push_string(ctx, "filename");
 	if (spriteset->filename != NULL)
 		duk_push_lstring(ctx, spriteset->filename->cstr, spriteset->filename->length);
@@ -451,48 +737,99 @@ duk_push_sphere_spriteset(duk_context* ctx, spriteset_t* spriteset)
 spriteset_t*
 duk_require_sphere_spriteset(duk_context* ctx, duk_idx_t index)
 {
-	spriteset_t* spriteset;
-	const char*  type;
+	return duk_require_sphere_obj(ctx, index, s_spriteset_type);
+}
+
+static void
+free_frame_atlas(struct frame_atlas* atlas)
+{
+	// the frames hold references to their pages, so this only releases ours
+	int i;
+
+	if (atlas->pages != NULL) {
+		for (i = 0; i < atlas->num_pages; ++i)
+			free_image(atlas->pages[i]);
+	}
+	free(atlas->pages);
+	atlas->pages = NULL;
+	atlas->num_pages = 0;
+}
+
+static unsigned int
+hash_pose_name(const char* name)
+{
+	// FNV-1a
+	unsigned int hash = 2166136261U;
+
+	while (*name != '\0')
+		hash = (hash ^ (unsigned char)*name++) * 16777619U;
+	return hash;
+}
 
-	index = duk_require_normalize_index(ctx, index);
-	duk_require_object_coercible(ctx, index);
-	if (!duk_get_prop_string(ctx, index, "\xFF" "sphere_type"))
+static bool
+init_frame_atlas(struct frame_atlas* atlas, int num_images, int cell_w, int cell_h)
+{
+	// frames are packed into a grid of equal cells sized to fit the largest one. when
+	// the grid won't fit in a single texture, it spills over onto additional pages.
+	int cells_left;
+	int max_size;
+	int num_rows;
+	
+	int i;
+
+	memset(atlas, 0, sizeof(struct frame_atlas));
+	max_size = g_display != NULL ? al_get_display_option(g_display, ALLEGRO_MAX_BITMAP_SIZE) : 0;
+	if (max_size <= 0) max_size = 2048;
+	if (num_images <= 0 || cell_w <= 0 || cell_h <= 0 || cell_w > max_size || cell_h > max_size)
+		return true;  // no atlas, frames get their own bitmaps
+	atlas->cell_w = cell_w;
+	atlas->cell_h = cell_h;
+	atlas->pitch = fmin(ceil(sqrt(num_images)), max_size / cell_w);
+	atlas->cells_per_page = atlas->pitch * (max_size / cell_h);
+	atlas->num_pages = (num_images + atlas->cells_per_page - 1) / atlas->cells_per_page;
+	if (!(atlas->pages = calloc(atlas->num_pages, sizeof(image_t*))))
 		goto on_error;
-	type = duk_get_string(ctx, -1); duk_pop(ctx);
-	if (strcmp(type, "spriteset") != 0) goto on_error;
-	duk_get_prop_string(ctx, index, "\xFF" "ptr");
-	spriteset = duk_get_pointer(ctx, -1); duk_pop(ctx);
-	return spriteset;
+	for (i = 0; i < atlas->num_pages; ++i) {
+		cells_left = num_images - i * atlas->cells_per_page;
+		num_rows = (fmin(cells_left, atlas->cells_per_page) + atlas->pitch - 1) / atlas->pitch;
+		if (!(atlas->pages[i] = create_image(atlas->pitch * cell_w, num_rows * cell_h)))
+			goto on_error;
+	}
+	return true;
 
 on_error:
-	duk_error_ni(ctx, -1, DUK_ERR_TYPE_ERROR, "Object is not a Sphere spriteset");
+	free_frame_atlas(atlas);
+	return false;
 }
 
-static const spriteset_pose_t*
-find_sprite_pose(const spriteset_t* spriteset, const char* pose_name)
+static bool
+key_sprite_poses(spriteset_t* spriteset)
 {
-	const char*             alt_name;
-	const char*             name_to_find;
-	const spriteset_pose_t* pose = NULL;
+	int name_id;
 	
 	int i;
 
-	alt_name = strcasecmp(pose_name, "northeast") == 0 ? "north"
-		: strcasecmp(pose_name, "southeast") == 0 ? "south"
-		: strcasecmp(pose_name, "southwest") == 0 ? "south"
-		: strcasecmp(pose_name, "northwest") == 0 ? "north"
-		: "";
-	name_to_find = pose_name;
-	do {
-		for (i = 0; i < spriteset->num_poses; ++i) {
-			if (strcasecmp(name_to_find, spriteset->poses[i].name->cstr) == 0) {
-				pose = &spriteset->poses[i];
-				break;
-			}
-		}
-		name_to_find = alt_name;
-	} while (pose == NULL && name_to_find != alt_name);
-	return pose != NULL ? pose : &spriteset->poses[0];
+	for (i = 0; i < spriteset->num_poses; ++i) {
+		if ((name_id = intern_pose_name(spriteset->poses[i].name->cstr)) < 0)
+			return false;
+		spriteset->poses[i].name_key = s_pose_names[name_id].key;
+	}
+	return true;
+}
+
+static image_t*
+read_atlas_frame(struct frame_atlas* atlas, memfile_t* file, int index, int width, int height)
+{
+	int      cell;
+	image_t* page;
+
+	if (atlas->num_pages == 0)
+		return read_image(file, width, height);
+	page = atlas->pages[index / atlas->cells_per_page];
+	cell = index % atlas->cells_per_page;
+	return read_subimage(file, page,
+		cell % atlas->pitch * atlas->cell_w, cell / atlas->pitch * atlas->cell_h,
+		width, height);
 }
 
 static duk_ret_t
@@ -517,7 +854,7 @@ js_Spriteset_finalize(duk_context* ctx)
 {
 	spriteset_t* spriteset;
 	
-	duk_get_prop_string(ctx, 0, "\xFF" "ptr"); spriteset = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	spriteset = duk_require_sphere_obj(ctx, 0, s_spriteset_type);
 	free_spriteset(spriteset);
 	return 0;
 }
@@ -536,7 +873,7 @@ js_Spriteset_clone(duk_context* ctx)
 	spriteset_t* spriteset;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); spriteset = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	spriteset = duk_require_sphere_obj(ctx, -1, s_spriteset_type);
 	duk_pop(ctx);
 	if ((new_spriteset = clone_spriteset(spriteset)) == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "Spriteset:clone(): Failed to create new spriteset");
@@ -553,7 +890,7 @@ js_Spriteset_get_image(duk_context* ctx)
 	spriteset_t* spriteset;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); spriteset = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	spriteset = duk_require_sphere_obj(ctx, -1, s_spriteset_type);
 	duk_pop(ctx);
 	duk_push_sphere_image(ctx, get_spriteset_image(spriteset, index));
 	return 1;
@@ -568,7 +905,7 @@ js_Spriteset_set_image(duk_context* ctx)
 	spriteset_t* spriteset;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); spriteset = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	spriteset = duk_require_sphere_obj(ctx, -1, s_spriteset_type);
 	duk_pop(ctx);
 	set_spriteset_image(spriteset, index, image);
 	return 0;
@@ -17,6 +17,7 @@ struct spriteset_frame
 struct spriteset_pose
 {
 	lstring_t*        name;
+	int               name_key;
 	int               num_frames;
 	spriteset_frame_t *frames;
 };
@@ -24,6 +25,7 @@ struct spriteset_pose
 struct spriteset
 {
 	int              refcount;
+	bool             is_shared;
 	rect_t           base;
 	lstring_t*       filename;
 	int              num_images;
@@ -32,16 +34,22 @@ struct spriteset
 	spriteset_pose_t *poses;
 };
 
+extern void         shutdown_spritesets     (void);
 extern spriteset_t* clone_spriteset         (const spriteset_t* spriteset);
 extern spriteset_t* load_spriteset          (const char* path);
+extern spriteset_t* load_shared_spriteset   (const char* path);
 extern spriteset_t* ref_spriteset           (spriteset_t* spriteset);
 extern void         free_spriteset          (spriteset_t* spriteset);
+extern int          intern_pose_name        (const char* name);
+extern const char*  get_pose_name           (int name_id);
+extern int          find_sprite_pose        (const spriteset_t* spriteset, int name_id);
 extern rect_t       get_sprite_base         (const spriteset_t* spriteset);
-extern int          get_sprite_frame_delay  (const spriteset_t* spriteset, const char* pose_name, int frame_index);
+extern int          get_sprite_frame_delay  (const spriteset_t* spriteset, int pose_index, int frame_index);
+extern void         get_sprite_frame_size   (const spriteset_t* spriteset, int pose_index, int frame_index, int* out_width, int* out_height);
 extern void         get_sprite_size         (const spriteset_t* spriteset, int* out_width, int* out_height);
 extern void         get_spriteset_info      (const spriteset_t* spriteset, int* out_num_images, int* out_num_poses);
 extern bool         get_spriteset_pose_info (const spriteset_t* spriteset, const char* pose_name, int* out_num_frames);
-extern void         draw_sprite             (const spriteset_t* spriteset, color_t mask, bool is_flipped, double theta, double scale_x, double scale_y, const char* pose_name, float x, float y, int frame_index);
+extern void         draw_sprite             (const spriteset_t* spriteset, color_t mask, bool is_flipped, double theta, double scale_x, double scale_y, int pose_index, float x, float y, int frame_index);
 
 extern void         init_spriteset_api           (duk_context* ctx);
 extern void         duk_push_sphere_spriteset    (duk_context* ctx, spriteset_t* spriteset);
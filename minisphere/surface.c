@@ -38,6 +38,8 @@ static duk_ret_t js_Surface_rectangle         (duk_context* ctx);
 static duk_ret_t js_Surface_rescale           (duk_context* ctx);
 static duk_ret_t js_Surface_save              (duk_context* ctx);
 
+static int s_surface_type = -1;
+
 void
 init_surface_api(void)
 {
@@ -53,6 +55,30 @@ init_surface_api(void)
 	register_api_func(g_duktape, NULL, "CreateSurface", js_CreateSurface);
 	register_api_func(g_duktape, NULL, "GrabSurface", js_GrabSurface);
 	register_api_func(g_duktape, NULL, "LoadSurface", js_LoadSurface);
+	s_surface_type = register_api_type(g_duktape, "Surface", js_Surface_finalize);
+	register_api_method(g_duktape, s_surface_type, "toString", js_Surface_toString);
+	register_api_method(g_duktape, s_surface_type, "getPixel", js_Surface_getPixel);
+	register_api_method(g_duktape, s_surface_type, "setAlpha", js_Surface_setAlpha);
+	register_api_method(g_duktape, s_surface_type, "setBlendMode", js_Surface_setBlendMode);
+	register_api_method(g_duktape, s_surface_type, "setPixel", js_Surface_setPixel);
+	register_api_method(g_duktape, s_surface_type, "applyLookup", js_Surface_applyLookup);
+	register_api_method(g_duktape, s_surface_type, "blit", js_Surface_blit);
+	register_api_method(g_duktape, s_surface_type, "blitMaskSurface", js_Surface_blitMaskSurface);
+	register_api_method(g_duktape, s_surface_type, "blitSurface", js_Surface_blitSurface);
+	register_api_method(g_duktape, s_surface_type, "clone", js_Surface_clone);
+	register_api_method(g_duktape, s_surface_type, "cloneSection", js_Surface_cloneSection);
+	register_api_method(g_duktape, s_surface_type, "createImage", js_Surface_createImage);
+	register_api_method(g_duktape, s_surface_type, "drawText", js_Surface_drawText);
+	register_api_method(g_duktape, s_surface_type, "flipHorizontally", js_Surface_flipHorizontally);
+	register_api_method(g_duktape, s_surface_type, "flipVertically", js_Surface_flipVertically);
+	register_api_method(g_duktape, s_surface_type, "gradientRectangle", js_Surface_gradientRectangle);
+	register_api_method(g_duktape, s_surface_type, "line", js_Surface_line);
+	register_api_method(g_duktape, s_surface_type, "outlinedRectangle", js_Surface_outlinedRectangle);
+	register_api_method(g_duktape, s_surface_type, "pointSeries", js_Surface_pointSeries);
+	register_api_method(g_duktape, s_surface_type, "rotate", js_Surface_rotate);
+	register_api_method(g_duktape, s_surface_type, "rectangle", js_Surface_rectangle);
+	register_api_method(g_duktape, s_surface_type, "rescale", js_Surface_rescale);
+	register_api_method(g_duktape, s_surface_type, "save", js_Surface_save);
 }
 
 void
@@ -60,33 +86,7 @@ duk_push_sphere_surface(duk_context* ctx, image_t* image)
 {
 	ref_image(image);
 
-	duk_push_object(ctx);
-	duk_push_string(ctx, "surface"); duk_put_prop_string(ctx, -2, "\xFF" "sphere_type");
-	duk_push_pointer(ctx, image); duk_put_prop_string(ctx, -2, "\xFF" "image_ptr");
-	duk_push_c_function(ctx, js_Surface_finalize, DUK_VARARGS); duk_set_finalizer(ctx, -2);
-	duk_push_c_function(ctx, js_Surface_toString, DUK_VARARGS); duk_put_prop_string(ctx, -2, "toString");
-	duk_push_c_function(ctx, js_Surface_getPixel, DUK_VARARGS); duk_put_prop_string(ctx, -2, "getPixel");
-	duk_push_c_function(ctx, js_Surface_setAlpha, DUK_VARARGS); duk_put_prop_string(ctx, -2, "setAlpha");
-	duk_push_c_function(ctx, js_Surface_setBlendMode, DUK_VARARGS); duk_put_prop_string(ctx, -2, "setBlendMode");
-	duk_push_c_function(ctx, js_Surface_setPixel, DUK_VARARGS); duk_put_prop_string(ctx, -2, "setPixel");
-	duk_push_c_function(ctx, js_Surface_applyLookup, DUK_VARARGS); duk_put_prop_string(ctx, -2, "applyLookup");
-	duk_push_c_function(ctx, js_Surface_blit, DUK_VARARGS); duk_put_prop_string(ctx, -2, "blit");
-	duk_push_c_function(ctx, js_Surface_blitMaskSurface, DUK_VARARGS); duk_put_prop_string(ctx, -2, "blitMaskSurface");
-	duk_push_c_function(ctx, js_Surface_blitSurface, DUK_VARARGS); duk_put_prop_string(ctx, -2, "blitSurface");
-	duk_push_c_function(ctx, js_Surface_clone, DUK_VARARGS); duk_put_prop_string(ctx, -2, "clone");
-	duk_push_c_function(ctx, js_Surface_cloneSection, DUK_VARARGS); duk_put_prop_string(ctx, -2, "cloneSection");
-	duk_push_c_function(ctx, js_Surface_createImage, DUK_VARARGS); duk_put_prop_string(ctx, -2, "createImage");
-	duk_push_c_function(ctx, js_Surface_drawText, DUK_VARARGS); duk_put_prop_string(ctx, -2, "drawText");
-	duk_push_c_function(ctx, js_Surface_flipHorizontally, DUK_VARARGS); duk_put_prop_string(ctx, -2, "flipHorizontally");
-	duk_push_c_function(ctx, js_Surface_flipVertically, DUK_VARARGS); duk_put_prop_string(ctx, -2, "flipVertically");
-	duk_push_c_function(ctx, js_Surface_gradientRectangle, DUK_VARARGS); duk_put_prop_string(ctx, -2, "gradientRectangle");
-	duk_push_c_function(ctx, js_Surface_line, DUK_VARARGS); duk_put_prop_string(ctx, -2, "line");
-	duk_push_c_function(ctx, js_Surface_outlinedRectangle, DUK_VARARGS); duk_put_prop_string(ctx, -2, "outlinedRectangle");
-	duk_push_c_function(ctx, js_Surface_pointSeries, DUK_VARARGS); duk_put_prop_string(ctx, -2, "pointSeries");
-	duk_push_c_function(ctx, js_Surface_rotate, DUK_VARARGS); duk_put_prop_string(ctx, -2, "rotate");
-	duk_push_c_function(ctx, js_Surface_rectangle, DUK_VARARGS); duk_put_prop_string(ctx, -2, "rectangle");
-	duk_push_c_function(ctx, js_Surface_rescale, DUK_VARARGS); duk_put_prop_string(ctx, -2, "rescale");
-	duk_push_c_function(ctx, js_Surface_save, DUK_VARARGS); duk_put_prop_string(ctx, -2, "save");
+	duk_push_sphere_obj(ctx, s_surface_type, image);
 	duk_push_string(ctx, "width"); duk_push_int(ctx, get_image_width(image));
 	duk_def_prop(ctx, -3,
 		DUK_DEFPROP_HAVE_CONFIGURABLE | 0
@@ -102,21 +102,7 @@ duk_push_sphere_surface(duk_context* ctx, image_t* image)
 image_t*
 duk_require_sphere_surface(duk_context* ctx, duk_idx_t index)
 {
-	image_t*    image;
-	const char* type;
-
-	index = duk_require_normalize_index(ctx, index);
-	duk_require_object_coercible(ctx, index);
-	if (!duk_get_prop_string(ctx, index, "\xFF" "sphere_type"))
-		goto on_error;
-	type = duk_get_string(ctx, -1); duk_pop(ctx);
-	if (strcmp(type, "surface") != 0) goto on_error;
-	duk_get_prop_string(ctx, index, "\xFF" "image_ptr");
-	image = duk_get_pointer(ctx, -1); duk_pop(ctx);
-	return image;
-
-on_error:
-	duk_error_ni(ctx, -1, DUK_ERR_TYPE_ERROR, "Object is not a Sphere surface");
+	return duk_require_sphere_obj(ctx, index, s_surface_type);
 }
 
 static void
@@ -226,7 +212,7 @@ js_Surface_finalize(duk_context* ctx)
 {
 	image_t* image;
 	
-	duk_get_prop_string(ctx, 0, "\xFF" "image_ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, 0, s_surface_type);
 	free_image(image);
 	return 0;
 }
@@ -248,7 +234,7 @@ js_Surface_setPixel(duk_context* ctx)
 	image_t* image;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "image_ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_surface_type);
 	duk_pop(ctx);
 	al_set_target_bitmap(get_image_bitmap(image));
 	al_put_pixel(x, y, nativecolor(color));
@@ -267,7 +253,7 @@ js_Surface_getPixel(duk_context* ctx)
 	uint8_t       r, g, b, alpha;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "image_ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_surface_type);
 	duk_pop(ctx);
 	pixel = al_get_pixel(get_image_bitmap(image), x, y);
 	al_unmap_rgba(pixel, &r, &g, &b, &alpha);
@@ -290,7 +276,7 @@ js_Surface_applyLookup(duk_context* ctx)
 	image_t* image;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "image_ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_surface_type);
 	duk_pop(ctx);
 	if (!apply_image_lookup(image, x, y, w, h, red_lu, green_lu, blue_lu, alpha_lu))
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "Surface:applyLookup(): Failed to apply lookup transformation (internal error)");
@@ -306,7 +292,7 @@ js_Surface_blit(duk_context* ctx)
 	image_t* image;
 	
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "image_ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_surface_type);
 	duk_pop(ctx);
 	if (!is_skipped_frame()) al_draw_bitmap(get_image_bitmap(image), x, y, 0x0);
 	return 0;
@@ -324,7 +310,7 @@ js_Surface_blitMaskSurface(duk_context* ctx)
 	image_t* image;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "image_ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_surface_type);
 	duk_get_prop_string(ctx, -1, "\xFF" "blend_mode"); blend_mode = duk_get_int(ctx, -1); duk_pop(ctx);
 	duk_pop(ctx);
 	apply_blend_mode(blend_mode);
@@ -346,7 +332,7 @@ js_Surface_blitSurface(duk_context* ctx)
 	image_t* image;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "image_ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_surface_type);
 	duk_get_prop_string(ctx, -1, "\xFF" "blend_mode"); blend_mode = duk_get_int(ctx, -1); duk_pop(ctx);
 	duk_pop(ctx);
 	apply_blend_mode(blend_mode);
@@ -364,7 +350,7 @@ js_Surface_clone(duk_context* ctx)
 	image_t* new_image;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "image_ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_surface_type);
 	duk_pop(ctx);
 	if ((new_image = clone_image(image)) == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "Surface:clone() - Unable to create new surface image");
@@ -385,7 +371,7 @@ js_Surface_cloneSection(duk_context* ctx)
 	image_t* new_image;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "image_ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_surface_type);
 	duk_pop(ctx);
 	if ((new_image = create_image(w, h)) == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "Surface:cloneSection() - Unable to create new surface image");
@@ -404,7 +390,7 @@ js_Surface_createImage(duk_context* ctx)
 	image_t* new_image;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "image_ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_surface_type);
 	duk_pop(ctx);
 	if ((new_image = clone_image(image)) == NULL)
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "Surface:createImage() - Failed to create new image bitmap");
@@ -426,7 +412,7 @@ js_Surface_drawText(duk_context* ctx)
 	image_t* image;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "image_ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_surface_type);
 	duk_get_prop_string(ctx, -1, "\xFF" "blend_mode"); blend_mode = duk_get_int(ctx, -1); duk_pop(ctx);
 	duk_pop(ctx);
 	duk_get_prop_string(ctx, 0, "\xFF" "color_mask"); color = duk_require_sphere_color(ctx, -1); duk_pop(ctx);
@@ -444,7 +430,7 @@ js_Surface_flipHorizontally(duk_context* ctx)
 	image_t* image;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "image_ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_surface_type);
 	duk_pop(ctx);
 	flip_image(image, true, false);
 	return 0;
@@ -456,7 +442,7 @@ js_Surface_flipVertically(duk_context* ctx)
 	image_t* image;
 	
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "image_ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_surface_type);
 	duk_pop(ctx);
 	flip_image(image, false, true);
 	return 0;
@@ -478,7 +464,7 @@ js_Surface_gradientRectangle(duk_context* ctx)
 	image_t*      image;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "image_ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_surface_type);
 	duk_get_prop_string(ctx, -1, "\xFF" "blend_mode"); blend_mode = duk_get_int(ctx, -1); duk_pop(ctx);
 	duk_pop(ctx);
 	apply_blend_mode(blend_mode);
@@ -509,7 +495,7 @@ js_Surface_line(duk_context* ctx)
 	image_t* image;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "image_ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_surface_type);
 	duk_get_prop_string(ctx, -1, "\xFF" "blend_mode"); blend_mode = duk_get_int(ctx, -1); duk_pop(ctx);
 	duk_pop(ctx);
 	apply_blend_mode(blend_mode);
@@ -536,7 +522,7 @@ js_Surface_pointSeries(duk_context* ctx)
 	unsigned int i;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "image_ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_surface_type);
 	duk_get_prop_string(ctx, -1, "\xFF" "blend_mode"); blend_mode = duk_get_int(ctx, -1); duk_pop(ctx);
 	duk_pop(ctx);
 	if (!duk_is_array(ctx, 0))
@@ -577,7 +563,7 @@ js_Surface_outlinedRectangle(duk_context* ctx)
 	image_t* image;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "image_ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_surface_type);
 	duk_get_prop_string(ctx, -1, "\xFF" "blend_mode"); blend_mode = duk_get_int(ctx, -1); duk_pop(ctx);
 	duk_pop(ctx);
 	apply_blend_mode(blend_mode);
@@ -597,7 +583,7 @@ js_Surface_rescale(duk_context* ctx)
 	image_t* image;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "image_ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_surface_type);
 	duk_pop(ctx);
 	if (!rescale_image(image, width, height))
 		duk_error_ni(ctx, -1, DUK_ERR_ERROR, "Surface:rescale() - Failed to rescale image (internal error)");
@@ -617,7 +603,7 @@ js_Surface_rotate(duk_context* ctx)
 	int      w, h;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "image_ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_surface_type);
 	duk_pop(ctx);
 	w = new_w = get_image_width(image);
 	h = new_h = get_image_height(image);
@@ -630,7 +616,7 @@ js_Surface_rotate(duk_context* ctx)
 	al_draw_rotated_bitmap(get_image_bitmap(image), (float)w / 2, (float)h / 2, (float)new_w / 2, (float)new_h / 2, angle, 0x0);
 	al_set_target_backbuffer(g_display);
 	duk_push_this(ctx);
-	duk_push_pointer(ctx, new_image); duk_put_prop_string(ctx, -2, "\xFF" "image_ptr");
+	duk_set_sphere_obj(ctx, -1, s_surface_type, new_image);
 	return 0;
 }
 
@@ -647,7 +633,7 @@ js_Surface_rectangle(duk_context* ctx)
 	int      blend_mode;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "image_ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_surface_type);
 	duk_get_prop_string(ctx, -1, "\xFF" "blend_mode"); blend_mode = duk_get_int(ctx, -1); duk_pop(ctx);
 	duk_pop(ctx);
 	apply_blend_mode(blend_mode);
@@ -667,7 +653,7 @@ js_Surface_save(duk_context* ctx)
 	char*    path;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "image_ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_surface_type);
 	duk_pop(ctx);
 	path = get_asset_path(filename, "images", true);
 	al_save_bitmap(path, get_image_bitmap(image));
@@ -681,7 +667,7 @@ js_Surface_setAlpha(duk_context* ctx)
 	image_t* image;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "image_ptr"); image = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	image = duk_require_sphere_obj(ctx, -1, s_surface_type);
 	duk_pop(ctx);
 	return 0;
 }
@@ -4,16 +4,29 @@
 
 #include "tileset.h"
 
+static bool arm_tile    (tileset_t* tileset, int tile_index);
+static void rearm_tiles (tileset_t* tileset, int tile_index);
+
 struct tileset
 {
-	int         width, height;
-	int         num_tiles;
-	struct tile *tiles;
+	int             width, height;
+	int             num_tiles;
+	struct tile     *tiles;
+	image_t*        atlas;
+	int             atlas_pitch;
+	ALLEGRO_COLOR   batch_color;
+	int             num_vertices;
+	int             max_vertices;
+	ALLEGRO_VERTEX* vertices;
+	int             num_anim_tiles;
+	int             max_anim_tiles;
+	int*            anim_tiles;
 };
 
 struct tile
 {
 	lstring_t* name;
+	int        atlas_index;
 	int        animate_index;
 	int        frames_left;
 	image_t*   image;
@@ -55,17 +68,17 @@ struct rts_tile_header
 tileset_t*
 load_tileset(const char* path)
 {
-	FILE*      file;
+	memfile_t* file;
 	tileset_t* tileset;
 
-	if ((file = fopen(path, "rb")) == NULL) return NULL;
+	if ((file = open_memfile(path)) == NULL) return NULL;
 	tileset = read_tileset(file);
-	fclose(file);
+	close_memfile(file);
 	return tileset;
 }
 
 tileset_t*
-read_tileset(FILE* file)
+read_tileset(memfile_t* file)
 {
 	image_t*               atlas = NULL;
 	int                    atlas_w, atlas_h;
@@ -82,9 +95,9 @@ read_tileset(FILE* file)
 	memset(&rts, 0, sizeof(struct rts_header));
 	
 	if (file == NULL) goto on_error;
-	file_pos = ftell(file);
+	file_pos = tell_memfile(file);
 	if ((tileset = calloc(1, sizeof(tileset_t))) == NULL) goto on_error;
-	if (fread(&rts, sizeof(struct rts_header), 1, file) != 1)
+	if (!read_memfile(file, &rts, sizeof(struct rts_header)))
 		goto on_error;
 	if (memcmp(rts.signature, ".rts", 4) != 0 || rts.version < 1 || rts.version > 1)
 		goto on_error;
@@ -107,9 +120,10 @@ read_tileset(FILE* file)
 
 	// read in tile headers and obstruction maps
 	for (i = 0; i < rts.num_tiles; ++i) {
-		if (fread(&tilehdr, sizeof(struct rts_tile_header), 1, file) != 1)
+		if (!read_memfile(file, &tilehdr, sizeof(struct rts_tile_header)))
 			goto on_error;
 		tiles[i].name = read_lstring_raw(file, tilehdr.name_length, true);
+		tiles[i].atlas_index = i;
 		tiles[i].next_index = tilehdr.animated ? tilehdr.next_tile : i;
 		tiles[i].delay = tilehdr.animated ? tilehdr.delay : 0;
 		tiles[i].animate_index = i;
@@ -117,13 +131,13 @@ read_tileset(FILE* file)
 		if (rts.has_obstructions) {
 			switch (tilehdr.obsmap_type) {
 			case 1:  // pixel-perfect obstruction (no longer supported)
-				fseek(file, rts.tile_width * rts.tile_height, SEEK_CUR);
+				seek_memfile(file, rts.tile_width * rts.tile_height, SEEK_CUR);
 				break;
 			case 2:  // line segment-based obstruction
 				tiles[i].num_obs_lines = tilehdr.num_segments;
 				if ((tiles[i].obsmap = new_obsmap()) == NULL) goto on_error;
 				for (j = 0; j < tilehdr.num_segments; ++j) {
-					if (!fread_rect_16(file, &segment))
+					if (!read_rect_16(file, &segment))
 						goto on_error;
 					add_obsmap_line(tiles[i].obsmap, segment);
 				}
@@ -134,24 +148,33 @@ read_tileset(FILE* file)
 		}
 	}
 
+	// only tiles with a running animation are kept in the animation list, so that
+	// animate_tileset() doesn't have to walk the whole tileset every frame
+	tileset->tiles = tiles;
+	tileset->num_tiles = rts.num_tiles;
+	for (i = 0; i < rts.num_tiles; ++i) {
+		if (tiles[i].frames_left > 0 && !arm_tile(tileset, i))
+			goto on_error;
+	}
+
 	// wrap things up
-	free_image(atlas);
+	tileset->atlas = atlas;
+	tileset->atlas_pitch = n_tiles_per_row;
 	tileset->width = rts.tile_width;
 	tileset->height = rts.tile_height;
-	tileset->num_tiles = rts.num_tiles;
-	tileset->tiles = tiles;
 	return tileset;
 
 on_error:  // oh no!
-	if (file != NULL) fseek(file, file_pos, SEEK_SET);
+	if (file != NULL) seek_memfile(file, file_pos, SEEK_SET);
 	if (tiles != NULL) {
 		for (i = 0; i < rts.num_tiles; ++i) {
 			free_lstring(tiles[i].name);
 			free_obsmap(tiles[i].obsmap);
 			free_image(tiles[i].image);
 		}
-		free(tileset->tiles);
+		free(tiles);
 	}
+	if (tileset != NULL) free(tileset->anim_tiles);
 	free_image(atlas);
 	free(tileset);
 	return NULL;
@@ -167,6 +190,9 @@ free_tileset(tileset_t* tileset)
 		free_image(tileset->tiles[i].image);
 		free_obsmap(tileset->tiles[i].obsmap);
 	}
+	free_image(tileset->atlas);
+	free(tileset->anim_tiles);
+	free(tileset->vertices);
 	free(tileset->tiles);
 	free(tileset);
 }
@@ -218,16 +244,24 @@ get_tile_size(const tileset_t* tileset, int* out_w, int* out_h)
 	*out_h = tileset->height;
 }
 
+bool
+is_tile_animated(const tileset_t* tileset, int tile_index)
+{
+	return tileset->tiles[tile_index].frames_left > 0;
+}
+
 void
 set_next_tile(tileset_t* tileset, int tile_index, int next_index)
 {
 	tileset->tiles[tile_index].next_index = next_index;
+	rearm_tiles(tileset, tile_index);
 }
 
 void
 set_tile_delay(tileset_t* tileset, int tile_index, int delay)
 {
 	tileset->tiles[tile_index].delay = delay;
+	rearm_tiles(tileset, tile_index);
 }
 
 void
@@ -237,6 +271,7 @@ set_tile_image(tileset_t* tileset, int tile_index, image_t* image)
 	
 	old_image = tileset->tiles[tile_index].image;
 	tileset->tiles[tile_index].image = ref_image(image);
+	tileset->tiles[tile_index].atlas_index = -1;
 	free_image(old_image);
 }
 
@@ -247,12 +282,16 @@ animate_tileset(tileset_t* tileset)
 	
 	int i;
 
-	for (i = 0; i < tileset->num_tiles; ++i) {
-		tile = &tileset->tiles[i];
-		if (tile->frames_left > 0 && --tile->frames_left == 0) {
+	for (i = 0; i < tileset->num_anim_tiles; ++i) {
+		tile = &tileset->tiles[tileset->anim_tiles[i]];
+		if (--tile->frames_left == 0) {
 			tile->animate_index = get_next_tile(tileset, tile->animate_index);
 			tile->frames_left = get_tile_delay(tileset, tile->animate_index);
 		}
+		if (tile->frames_left <= 0) {
+			// animation has stopped, drop the tile from the list
+			tileset->anim_tiles[i--] = tileset->anim_tiles[--tileset->num_anim_tiles];
+		}
 	}
 }
 
@@ -261,5 +300,107 @@ draw_tile(const tileset_t* tileset, color_t mask, float x, float y, int tile_ind
 {
 	tile_index = tileset->tiles[tile_index].animate_index;
 	al_draw_tinted_bitmap(get_image_bitmap(tileset->tiles[tile_index].image),
-		al_map_rgba(mask.r, mask.g, mask.b, mask.alpha), x, y, 0x0);
+		nativecolor(mask), x, y, 0x0);
+}
+
+void
+begin_tile_batch(tileset_t* tileset, color_t mask)
+{
+	tileset->batch_color = nativecolor(mask);
+	tileset->num_vertices = 0;
+}
+
+void
+batch_tile(tileset_t* tileset, float x, float y, int tile_index)
+{
+	int             new_max;
+	ALLEGRO_VERTEX* new_buffer;
+	ALLEGRO_VERTEX* v;
+	float           u1, v1, u2, v2;
+	float           x2, y2;
+	
+	tile_index = tileset->tiles[tile_index].animate_index;
+	if (tileset->tiles[tile_index].atlas_index < 0)
+		goto draw_now;
+	if (tileset->num_vertices + 6 > tileset->max_vertices) {
+		new_max = fmax(tileset->max_vertices * 2, 6 * 256);
+		if (!(new_buffer = realloc(tileset->vertices, new_max * sizeof(ALLEGRO_VERTEX))))
+			goto draw_now;
+		tileset->vertices = new_buffer;
+		tileset->max_vertices = new_max;
+	}
+	
+	// two triangles per tile, textured from the tile's cell in the atlas
+	u1 = tileset->tiles[tile_index].atlas_index % tileset->atlas_pitch * tileset->width;
+	v1 = tileset->tiles[tile_index].atlas_index / tileset->atlas_pitch * tileset->height;
+	u2 = u1 + tileset->width; v2 = v1 + tileset->height;
+	x2 = x + tileset->width; y2 = y + tileset->height;
+	v = &tileset->vertices[tileset->num_vertices];
+	v[0].x = x; v[0].y = y; v[0].u = u1; v[0].v = v1;
+	v[1].x = x2; v[1].y = y; v[1].u = u2; v[1].v = v1;
+	v[2].x = x; v[2].y = y2; v[2].u = u1; v[2].v = v2;
+	v[3].x = x2; v[3].y = y; v[3].u = u2; v[3].v = v1;
+	v[4].x = x2; v[4].y = y2; v[4].u = u2; v[4].v = v2;
+	v[5].x = x; v[5].y = y2; v[5].u = u1; v[5].v = v2;
+	v[0].z = v[1].z = v[2].z = v[3].z = v[4].z = v[5].z = 0;
+	v[0].color = v[1].color = v[2].color = v[3].color = v[4].color = v[5].color = tileset->batch_color;
+	tileset->num_vertices += 6;
+	return;
+
+draw_now:
+	// tile image isn't in the atlas (e.g. it was replaced using SetTileImage()),
+	// so it can't be batched
+	al_draw_tinted_bitmap(get_image_bitmap(tileset->tiles[tile_index].image),
+		tileset->batch_color, x, y, 0x0);
+}
+
+void
+end_tile_batch(tileset_t* tileset)
+{
+	if (tileset->num_vertices > 0) {
+		al_draw_prim(tileset->vertices, NULL, get_image_bitmap(tileset->atlas),
+			0, tileset->num_vertices, ALLEGRO_PRIM_TRIANGLE_LIST);
+	}
+	tileset->num_vertices = 0;
+}
+
+static bool
+arm_tile(tileset_t* tileset, int tile_index)
+{
+	int*         new_list;
+	struct tile* tile;
+
+	tile = &tileset->tiles[tile_index];
+	if (tile->frames_left <= 0) {
+		// tile isn't animating yet, start it up if the current frame has a delay
+		tile->frames_left = get_tile_delay(tileset, tile->animate_index);
+		if (tile->frames_left <= 0)
+			return true;
+	}
+	if (++tileset->num_anim_tiles > tileset->max_anim_tiles) {
+		tileset->max_anim_tiles = tileset->num_anim_tiles * 2;
+		if (!(new_list = realloc(tileset->anim_tiles, tileset->max_anim_tiles * sizeof(int))))
+			goto on_error;
+		tileset->anim_tiles = new_list;
+	}
+	tileset->anim_tiles[tileset->num_anim_tiles - 1] = tile_index;
+	return true;
+
+on_error:
+	--tileset->num_anim_tiles;
+	tile->frames_left = 0;
+	return false;
+}
+
+static void
+rearm_tiles(tileset_t* tileset, int tile_index)
+{
+	// a stopped tile is parked on whatever frame it reached, which isn't necessarily
+	// itself, so restart every stopped tile currently showing the edited one
+	int i;
+
+	for (i = 0; i < tileset->num_tiles; ++i) {
+		if (tileset->tiles[i].animate_index == tile_index && tileset->tiles[i].frames_left <= 0)
+			arm_tile(tileset, i);
+	}
 }
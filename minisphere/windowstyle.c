@@ -12,7 +12,8 @@ static duk_ret_t js_WindowStyle_toString     (duk_context* ctx);
 static duk_ret_t js_WindowStyle_drawWindow   (duk_context* ctx);
 static duk_ret_t js_WindowStyle_setColorMask (duk_context* ctx);
 
-static windowstyle_t* s_sys_winstyle = NULL;
+static windowstyle_t* s_sys_winstyle  = NULL;
+static int            s_winstyle_type = -1;
 
 enum wstyle_bg_type
 {
@@ -52,7 +53,7 @@ windowstyle_t*
 load_windowstyle(const char* path)
 {
 	image_t*          atlas = NULL;
-	FILE*             file;
+	memfile_t*        file;
 	image_t*          image;
 	int16_t           max_w = 0, max_h = 0;
 	struct rws_header rws;
@@ -60,9 +61,9 @@ load_windowstyle(const char* path)
 	windowstyle_t*    winstyle = NULL;
 	int               i;
 
-	if (!(file = fopen(path, "rb"))) goto on_error;
+	if (!(file = open_memfile(path))) goto on_error;
 	if ((winstyle = calloc(1, sizeof(windowstyle_t))) == NULL) goto on_error;
-	if (fread(&rws, sizeof(struct rws_header), 1, file) != 1)
+	if (!read_memfile(file, &rws, sizeof(struct rws_header)))
 		goto on_error;
 	if (memcmp(rws.signature, ".rws", 4) != 0) goto on_error;
 	switch (rws.version) {
@@ -78,7 +79,7 @@ load_windowstyle(const char* path)
 		break;
 	case 2:
 		for (i = 0; i < 9; ++i) {
-			if (fread(&w, 2, 1, file) != 1 || fread(&h, 2, 1, file) != 1)
+			if (!read_memfile(file, &w, 2) || !read_memfile(file, &h, 2))
 				goto on_error;
 			if ((image = read_image(file, w, h)) == NULL) goto on_error;
 			winstyle->images[i] = image;
@@ -87,13 +88,13 @@ load_windowstyle(const char* path)
 	default:  // invalid version number
 		goto on_error;
 	}
-	fclose(file);
+	close_memfile(file);
 	winstyle->bg_style = rws.background_mode;
 	free_image(atlas);
 	return ref_windowstyle(winstyle);
 
 on_error:
-	if (file != NULL) fclose(file);
+	close_memfile(file);
 	if (winstyle != NULL) {
 		for (i = 0; i < 9; ++i)
 			free_image(winstyle->images[i]);
@@ -180,6 +181,10 @@ init_windowstyle_api(void)
 	// register windowstyle API functions
 	register_api_func(g_duktape, NULL, "GetSystemWindowStyle", js_GetSystemWindowStyle);
 	register_api_func(g_duktape, NULL, "LoadWindowStyle", js_LoadWindowStyle);
+	s_winstyle_type = register_api_type(g_duktape, "WindowStyle", js_WindowStyle_finalize);
+	register_api_method(g_duktape, s_winstyle_type, "toString", js_WindowStyle_toString);
+	register_api_method(g_duktape, s_winstyle_type, "drawWindow", js_WindowStyle_drawWindow);
+	register_api_method(g_duktape, s_winstyle_type, "setColorMask", js_WindowStyle_setColorMask);
 }
 
 void
@@ -187,13 +192,8 @@ duk_push_sphere_windowstyle(duk_context* ctx, windowstyle_t* winstyle)
 {
 	ref_windowstyle(winstyle);
 	
-	duk_push_object(ctx);
-	duk_push_pointer(ctx, winstyle); duk_put_prop_string(ctx, -2, "\xFF" "ptr");
+	duk_push_sphere_obj(ctx, s_winstyle_type, winstyle);
 	duk_push_sphere_color(ctx, rgba(255, 255, 255, 255)); duk_put_prop_string(ctx, -2, "\xFF" "color_mask");
-	duk_push_c_function(ctx, js_WindowStyle_finalize, DUK_VARARGS); duk_set_finalizer(ctx, -2);
-	duk_push_c_function(ctx, js_WindowStyle_toString, DUK_VARARGS); duk_put_prop_string(ctx, -2, "toString");
-	duk_push_c_function(ctx, js_WindowStyle_drawWindow, DUK_VARARGS); duk_put_prop_string(ctx, -2, "drawWindow");
-	duk_push_c_function(ctx, js_WindowStyle_setColorMask, DUK_VARARGS); duk_put_prop_string(ctx, -2, "setColorMask");
 }
 
 static duk_ret_t
@@ -227,7 +227,7 @@ js_WindowStyle_finalize(duk_context* ctx)
 {
 	windowstyle_t* winstyle;
 
-	duk_get_prop_string(ctx, 0, "\xFF" "ptr"); winstyle = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	winstyle = duk_require_sphere_obj(ctx, 0, s_winstyle_type);
 	free_windowstyle(winstyle);
 	return 0;
 }
@@ -251,7 +251,7 @@ js_WindowStyle_drawWindow(duk_context* ctx)
 	windowstyle_t* winstyle;
 
 	duk_push_this(ctx);
-	duk_get_prop_string(ctx, -1, "\xFF" "ptr"); winstyle = duk_get_pointer(ctx, -1); duk_pop(ctx);
+	winstyle = duk_require_sphere_obj(ctx, -1, s_winstyle_type);
 	duk_get_prop_string(ctx, -1, "\xFF" "color_mask"); mask = duk_require_sphere_color(ctx, -1); duk_pop(ctx);
 	duk_pop(ctx);
 	draw_window(winstyle, mask, x, y, w, h);